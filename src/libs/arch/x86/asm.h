@@ -93,6 +93,14 @@ public:
         asm volatile("mov %0, %%cr0" : : "r" (val));
     }
 
+    // linear address that caused last page fault
+    static inline uint32_t
+    get_cr2() {
+        uint32_t val;
+        asm volatile("mov %%cr2, %0;" : "=r" (val));
+        return val;
+    }
+
     static inline uint32_t
     get_cr3() {
         uint32_t val;
@@ -105,6 +113,81 @@ public:
         asm volatile("mov %0, %%cr3" : : "r" (val));
     }
 
+    static inline uint32_t
+    get_cr4() {
+        uint32_t val;
+        asm volatile("mov %%cr4, %0;" : "=r" (val));
+        return val;
+    }
+
+    static inline void
+    set_cr4(uint32_t val) {
+        asm volatile("mov %0, %%cr4" : : "r" (val) : "memory");
+    }
+
+    static inline void
+    cpuid(uint32_t  leaf,
+          uint32_t& eax,
+          uint32_t& ebx,
+          uint32_t& ecx,
+          uint32_t& edx)
+    {
+        asm volatile("cpuid"
+            : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+            : "a" (leaf), "c" (0));
+    }
+
+    // time stamp counter, counts cpu cycles since reset
+    static inline uint64_t
+    rdtsc() {
+        uint32_t lo, hi;
+        asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+        return ((uint64_t)hi << 32) | lo;
+    }
+
+    // 64-bit by 32-bit division. i386 has no instruction for it and
+    // we don't link libgcc, so do it in two 'divl's, each one divides
+    // a 64-bit value whose high part is less than 'd'.
+    static inline uint64_t
+    div64(uint64_t n, uint32_t d, uint32_t* rem = nullptr) {
+        uint32_t hi = (uint32_t)(n >> 32);
+        uint32_t lo = (uint32_t)n;
+        uint32_t qh = hi / d;
+        uint32_t ql, r;
+        asm("divl %4"
+            : "=a" (ql), "=d" (r)
+            : "a" (lo), "d" (hi % d), "rm" (d));
+        if(rem != nullptr) {
+            *rem = r;
+        }
+        return ((uint64_t)qh << 32) | ql;
+    }
+
+    // invalidate TLB entry of the page contains 'addr'
+    static inline void
+    invlpg(uint32_t addr) {
+        asm volatile("invlpg (%0)" : : "r" (addr) : "memory");
+    }
+
+    // reloading cr3 invalidates all TLB entries (except global ones)
+    static inline void
+    flush_tlb() {
+        set_cr3(get_cr3());
+    }
+
+    // invalidates all TLB entries including global ones. toggling
+    // CR4.PGE is the way to drop global entries without invlpg.
+    static inline void
+    flush_global() {
+        uint32_t cr4 = get_cr4();
+        if(lkl::bit_test(cr4, CR4_PGE)) {
+            set_cr4(cr4 & ~CR4_PGE);
+            set_cr4(cr4);
+        } else {
+            flush_tlb();
+        }
+    }
+
     static inline void
     load_gdt(const gdt_desc_t *gdt) {
         asm volatile("lgdt %0"::"m" (*gdt));
@@ -161,6 +244,25 @@ public:
             eflags_t::FLAG_IF);
     }
 
+    // spin-wait hint, 'rep; nop' on cpus without 'pause'
+    static inline void
+    cpu_relax() {
+        asm volatile("pause" : : : "memory");
+    }
+
+    // stop until next interrupt
+    static inline void
+    halt() {
+        asm volatile("hlt" : : : "memory");
+    }
+
+    // 'sti' takes effect after next instruction, so no interrupt can
+    // sneak in between 'sti' and 'hlt' and get lost.
+    static inline void
+    wait_for_interrupt() {
+        asm volatile("sti; hlt" : : : "memory");
+    }
+
     static inline void
     set_interrupt(bool intr) {
         if(intr) {
@@ -184,6 +286,65 @@ public:
         CR0_PE   = 0x0000'0001, // Protection Enable (bit 0)
     };
 
+    enum
+    {
+        CR4_PSE  = 0x0000'0010, // Page Size Extensions (bit 4)
+        CR4_PAE  = 0x0000'0020, // Physical Address Extension (bit 5)
+        CR4_PGE  = 0x0000'0080, // Page Global Enable (bit 7)
+    };
+
+    // cpuid leaf 1, edx
+    enum
+    {
+        CPUID_PSE = 0x0000'0008, // 4MB pages (bit 3)
+        CPUID_TSC = 0x0000'0010, // time stamp counter (bit 4)
+        CPUID_PGE = 0x0000'2000, // global pages (bit 13)
+    };
+
+    // feature bits of cpuid leaf 1, edx
+    static inline uint32_t
+    cpu_features() {
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(1, eax, ebx, ecx, edx);
+        return edx;
+    }
+
+    static inline bool
+    has_tsc() {
+        return lkl::bit_test(cpu_features(), CPUID_TSC);
+    }
+
+    static inline bool
+    has_pse() {
+        return lkl::bit_test(cpu_features(), CPUID_PSE);
+    }
+
+    static inline bool
+    is_pse_on() {
+        return lkl::bit_test(get_cr4(), CR4_PSE);
+    }
+
+    static inline void
+    turn_pse_on() {
+        __inner_set_reg_state(get_cr4, set_cr4, true, CR4_PSE);
+    }
+
+    static inline bool
+    has_pge() {
+        return lkl::bit_test(cpu_features(), CPUID_PGE);
+    }
+
+    static inline bool
+    is_pge_on() {
+        return lkl::bit_test(get_cr4(), CR4_PGE);
+    }
+
+    // global pages survive cr3 reloads
+    static inline void
+    turn_pge_on() {
+        __inner_set_reg_state(get_cr4, set_cr4, true, CR4_PGE);
+    }
+
     static inline bool
     is_protected_mode() {
         return lkl::bit_test(x86_asm::get_cr0(), CR0_PE);
@@ -272,10 +433,10 @@ private:
         // old value
         uint32_t ov = rd();
         bool os = lkl::bit_test(ov, flag);
-        // set cr0 if old state != new state
+        // set register if old state != new state
         if(os != ns) {
             // set flag
-            lkl::bit_set(ov, CR0_PG, ns);
+            lkl::bit_set(ov, flag, ns);
             // write flag
             wt(ov);
         }
@@ -81,6 +81,9 @@
 inline extern const int
 PAGE_SIZE      = 0x00001000;
 
+inline extern const int
+LARGE_PAGE_SIZE = 0x00400000; // a PDE with PS set maps 4MB
+
 inline extern const int
 PD_ENT_NUM     = 0x00000400; // page-dir entry num
 
@@ -124,7 +127,8 @@ struct raw_pde_t
     bool     a       :  1; // accessed
     bool     ign1    :  1; // ignored
     bool     ps      :  1; // page size, used when cr4.pse = 1
-    uint8_t  ign2    :  4; // ignored
+    bool     g       :  1; // global, 4MB page only
+    uint8_t  ign2    :  3; // ignored
     uint32_t address : 20; // physical address of 4k aligned page table
 };
 
@@ -299,6 +303,30 @@ public:
     ps(bool p) {
         _pde.ps = p;
     }
+
+    // Global (4MB page only):
+    // if cr4.PGE = 1, determines whether the translation is global;
+    // ignored if this entry points to a page table.
+    inline bool
+    global() const {
+        return _pde.g;
+    }
+
+    // Global (4MB page only):
+    // never set it on an entry points to a page table, the self-mapped
+    // PDE (1023) reads such an entry as a PTE.
+    inline void
+    global(bool g) {
+        _pde.g = g;
+    }
+
+    // physical address of 4MB page, valid if ps() is set.
+    // bit 12-21 are PAT and high address bits under PSE-36, they're
+    // always 0 here.
+    inline uint32_t
+    large_address() const {
+        return _value & MASK_H10_BITS;
+    }
 };
 
 class pte_t : public pge_t
@@ -128,6 +128,23 @@
 ; 
 
 extern main_cxx_isr
+extern isr_account
+
+; per-vector statistics: entry stamps TSC into 'isr_tsc' if 'isr_timing'
+; is set, 'isr_account' charges the cycles to the vector after handler
+; returned. see intr_mgr::enable_stats.
+extern isr_tsc
+extern isr_timing
+
+; deferred work raised by handlers runs here with interrupt on,
+; see softirq_mgr.
+extern softirq_run
+
+; error code of current exception (0 if it has none) and eflags of the
+; interrupted code, handlers read them through intr_mgr::err_code and
+; intr_mgr::intr_was_on.
+extern isr_err
+extern isr_eflags
 
 ; we cannot use C/C++ to write functions which using 'iret' to return to 
 ; callers. that's the reason we are writing those intr_?_entry.
@@ -156,14 +173,36 @@ isr_%1:
     push    gs
     pushad  ; backup EAX ECX EDX EBX ESP EBP ESI and EDI
 
+    ; first parameter is above 8 registers and 4 segment registers,
+    ; then eip, cs and eflags pushed by CPU
+    mov     eax, [esp + 48]
+    mov     [isr_err], eax
+    mov     eax, [esp + 60]
+    mov     [isr_eflags], eax
+
     mov     al, 0x20 ; EOI(End of Interrupt) signal
     out     0xa0, al ; send to 8259A master port
     out     0x20, al ; send to 8259A slave port
 
+    cmp     byte [isr_timing], 0
+    je      %%untimed
+    rdtsc
+    mov     [isr_tsc], eax
+    mov     [isr_tsc+4], edx
+%%untimed:
+
     push    %1 ; push second parameter
 
     call    main_cxx_isr
 
+    ; callee owns its parameter slot and may have changed it, push
+    ; vector number again.
+    push    %1
+    call    isr_account
+    add     esp, 4
+
+    call    softirq_run
+
     ; all entries share same exit code.
     jmp     isr_exit
 
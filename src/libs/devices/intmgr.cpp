@@ -63,4 +63,103 @@ intr_mgr::irq_to_name(uint32_t vct) {
         return s_irq_names[vct];
     }
     return s_err_irq;
+}
+
+void
+intr_mgr::dispatch(uint32_t vct) {
+    ASSERT(vct < SYSTEM_IRQ_COUNT);
+
+    auto han = _irq_handlers[vct];
+    if(han != nullptr) {
+        han(vct);
+    } else {
+        dbg_msg(irq_to_name(vct));
+        dbg_ln();
+    }
+}
+
+// TSC stamped at ISR entry, 0 if the handler isn't timed
+extern "C"
+{
+    uint64_t isr_tsc    = 0;
+    uint8_t  isr_timing = 0;
+    uint32_t isr_err    = 0;
+    uint32_t isr_eflags = 0;
+}
+
+void
+intr_mgr::account(uint32_t vct) {
+    ASSERT(vct < SYSTEM_IRQ_COUNT);
+
+    auto& st = _stats[vct];
+    if(isr_tsc == 0) {
+        ++st.untimed;
+        return;
+    }
+
+    uint32_t cyc = (uint32_t)(x86_asm::rdtsc() - isr_tsc);
+    isr_tsc = 0;
+    st.cycles.add(cyc);
+    ++st.hist[cyc != 0 ? bit_msb(cyc) : 0];
+}
+
+void
+intr_mgr::enable_stats(bool on) {
+    intr_guard guard(false);
+    isr_timing = on && x86_asm::has_tsc();
+    isr_tsc    = 0;
+}
+
+void
+intr_mgr::cancel_timing() {
+    isr_tsc = 0;
+}
+
+void
+intr_mgr::reset_stats() {
+    intr_guard guard(false);
+    for(auto& st : _stats) {
+        st = irq_stats_t();
+    }
+}
+
+void
+intr_mgr::dump_stats(print_t<def_screen_t, x86_io>& pr) const {
+    pr.show("vct count avg max untimed\n");
+    for(uint32_t i = 0; i < SYSTEM_IRQ_COUNT; ++i) {
+        auto& st = _stats[i];
+        if(st.count() == 0) {
+            continue;
+        }
+
+        pr.hex(i, false, false);  pr.show(" ");
+        pr.show(st.count());      pr.show(" ");
+        pr.show(st.cycles.avg()); pr.show(" ");
+        pr.show(st.cycles.max);   pr.show(" ");
+        pr.show(st.untimed);      pr.show(" ");
+        pr.show(irq_to_name(i));
+        pr.line_feed();
+
+        // log2 buckets, empty ones are skipped
+        pr.show("  ");
+        for(uint32_t b = 0; b < irq_stats_t::IRQ_HIST_BUCKETS; ++b) {
+            if(st.hist[b] == 0) {
+                continue;
+            }
+            pr.show(b);  pr.show(":");
+            pr.show(st.hist[b]); pr.show(" ");
+        }
+        pr.line_feed();
+    }
+}
+
+// common entry of all ISRs in int.s
+extern "C" void
+main_cxx_isr(uint32_t vct) {
+    intr_mgr::instance().dispatch(vct);
+}
+
+extern "C" void
+isr_account(uint32_t vct) {
+    intr_mgr::instance().account(vct);
 }
\ No newline at end of file
@@ -3,11 +3,21 @@
 #include <x86/asm.h>
 #include <bit.h>
 #include <debug.h>
+#include <clock.h>
+#include <print.h>
 
 inline extern const int
 SYSTEM_IRQ_COUNT = 0x30;
 
-typedef void (*irq_handler)();
+// 'vct' is the interrupt vector
+typedef void (*irq_handler)(uint32_t vct);
+
+// entries defined in int.s, they save context and call 'main_cxx_isr'
+extern "C" uint32_t isr_tbl[];
+
+// error code and eflags pushed by CPU, stored by int.s on every entry
+extern "C" uint32_t isr_err;
+extern "C" uint32_t isr_eflags;
 
 class intr_guard
 {
@@ -41,11 +51,34 @@ private:
     }
 };
 
+// statistics of an interrupt vector
+struct irq_stats_t
+{
+    enum
+    {
+        IRQ_HIST_BUCKETS = 32
+    };
+
+    // timed handlers
+    lkl::cycle_stats_t cycles;
+    // handlers switched to another thread or taken with timing off,
+    // they are counted but not timed.
+    uint32_t           untimed = 0;
+    // bucket 'n' counts handlers took [2^n, 2^(n+1)) cycles
+    uint32_t           hist[IRQ_HIST_BUCKETS] = {};
+
+    inline uint32_t
+    count() const {
+        return cycles.count + untimed;
+    }
+};
+
 class intr_mgr
 {
     bool _initialized : 1 = false;
 private:
-    irq_handler _irq_handlers[SYSTEM_IRQ_COUNT];
+    irq_handler _irq_handlers[SYSTEM_IRQ_COUNT] = {};
+    irq_stats_t _stats[SYSTEM_IRQ_COUNT];
 private:
     intr_mgr() = default;
 public:
@@ -107,7 +140,7 @@ public:
         for(uint32_t i = 0; i < SYSTEM_IRQ_COUNT; ++i) {
             idesc[i].reset(
                 GDT_CODE_SELECTOR,
-                (uint32_t)_irq_handlers[i]);
+                isr_tbl[i]);
             idesc[i].present(true);
         }
 
@@ -127,6 +160,51 @@ public:
         _irq_handlers[no] = handler;
     }
 
+    // called by 'main_cxx_isr', vectors without a handler just print
+    // their names.
+    void
+    dispatch(uint32_t vct);
+
+    // called by int.s after handler returned
+    void
+    account(uint32_t vct);
+
+    // timing needs TSC, counting works without it.
+    static void
+    enable_stats(bool on);
+
+    // a thread switch inside a handler would charge other threads'
+    // time to it. task_mgr calls this before switching.
+    static void
+    cancel_timing();
+
+    const irq_stats_t&
+    stats(uint32_t vct) const {
+        ASSERT(vct < SYSTEM_IRQ_COUNT);
+        return _stats[vct];
+    }
+
+    void
+    reset_stats();
+
+    // error code of the exception being handled, valid only inside
+    // its handler. 0 for vectors without one.
+    static inline uint32_t
+    err_code() {
+        return isr_err;
+    }
+
+    // whether the interrupted code had interrupt on, valid only inside
+    // a handler.
+    static inline bool
+    intr_was_on() {
+        return (isr_eflags & intr_guard::EFLAGS_IF) != 0;
+    }
+
+    // one line for each vector ever taken, then its histogram
+    void
+    dump_stats(lkl::print_t<lkl::def_screen_t, x86_io>& pr) const;
+
     static const char*
     irq_to_name(uint32_t vct);
 
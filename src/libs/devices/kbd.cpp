@@ -4,6 +4,7 @@
 // #include <x86/idt.h>
 #include <kbd.h>
 #include <inbb.h>
+#include <softirq.h>
 
 lkl::inbb_t g_kbd_buffer;
 
@@ -23,13 +24,20 @@ keyboard::init()
 void
 keyboard::keyboard_handler(uint32_t vct) 
 {
-    
+    // scan code must be read now, the rest can wait
     auto sc = x86_io::inb(KBD_PORT);
-    if(s_modifiers.update(sc))
+    lkl::softirq_mgr::raise(keyboard_decode, sc);
+}
+
+void
+keyboard::keyboard_decode(uint32_t sc)
+{
+    // softirqs run one by one, modifiers need no lock
+    if(s_modifiers.update((uint8_t)sc))
         return;
     
-    lkl::scode_t scode(sc, s_modifiers);
+    lkl::scode_t scode((uint8_t)sc, s_modifiers);
     //char ch = scode.to_char();
-    g_kbd_buffer.putc(scode);
-    
+    // a softirq can't wait for reader, drop keys it doesn't keep up
+    g_kbd_buffer.try_putc(scode);
 }
@@ -24,9 +24,14 @@ public:
         return lkl::bit_test(s_states, KBS_INITED);
     }
     
+    // ISR, reads scan code and leaves decoding to 'keyboard_decode'
     static void
     keyboard_handler(uint32_t vct);
 
+    // softirq, runs with interrupt on
+    static void
+    keyboard_decode(uint32_t sc);
+
 private:
     keyboard() = delete;
 };
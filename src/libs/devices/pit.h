@@ -98,8 +98,17 @@ public:
         PIT_CNTR1_PORT  = 0x41,
         PIT_CNTR2_PORT  = 0x42,
         PIT_INPUT_FREQ  = 1193181,
-        PIT_RW_LATCH    = 3,
-        PIT_OPT_MODE    = 2
+        PIT_SEL_CNTR0   = 0,    // SC bits of control word
+        PIT_SEL_CNTR2   = 2,
+        PIT_RW_COUNT    = 0,    // counter latch command
+        PIT_RW_LATCH    = 3,    // low byte then high byte
+        PIT_OPT_MODE    = 2,
+        // channel 2 gate and output live in keyboard controller port B
+        PIT_CNTR2_GATE  = 0x61,
+        PIT_GATE2_BIT   = 0x01, // gate input of counter 2
+        PIT_SPKR_BIT    = 0x02, // speaker data, keep it off
+        PIT_OUT2_BIT    = 0x20, // output of counter 2 (read-only)
+        PIT_MODE_TC     = 0     // mode 0: interrupt on terminal count
     };
 public:
     void
@@ -111,7 +120,7 @@ public:
         x86_io::outb(
              PIT_CTRL_PORT, 
             (uint8_t)
-            (PIT_CNTR0_PORT << 6 |
+            (PIT_SEL_CNTR0   << 6 |
              PIT_RW_LATCH    << 4 |
              PIT_OPT_MODE    << 1));
         
@@ -120,6 +129,67 @@ public:
         x86_io::outb(PIT_CNTR0_PORT, (uint8_t)cnt);
         x86_io::outb(PIT_CNTR0_PORT, (uint8_t)(cnt>>8));
     }
+
+    // counter 0 in mode 0: IRQ0 fires once after 'cnt' input clocks,
+    // then nothing until it's written again. 'cnt' = 0 means 65536.
+    void
+    oneshot(uint16_t cnt)
+    {
+        x86_io::outb(
+             PIT_CTRL_PORT,
+            (uint8_t)
+            (PIT_SEL_CNTR0   << 6 |
+             PIT_RW_LATCH    << 4 |
+             PIT_MODE_TC     << 1));
+
+        x86_io::outb(PIT_CNTR0_PORT, (uint8_t)cnt);
+        x86_io::outb(PIT_CNTR0_PORT, (uint8_t)(cnt>>8));
+    }
+
+    // current value of counter 0. latch command freezes it for reading
+    // while counting goes on. in mode 0 it keeps counting down past 0
+    // and wraps around.
+    uint16_t
+    count()
+    {
+        x86_io::outb(
+             PIT_CTRL_PORT,
+            (uint8_t)
+            (PIT_SEL_CNTR0   << 6 |
+             PIT_RW_COUNT    << 4));
+
+        uint16_t lo = x86_io::inb(PIT_CNTR0_PORT);
+        uint16_t hi = x86_io::inb(PIT_CNTR0_PORT);
+        return (uint16_t)(hi << 8 | lo);
+    }
+
+    // run counter 2 once from 'cnt' down to 0 with speaker off.
+    // it isn't wired to any IRQ, poll 'cntr2_out' to see it finish.
+    void
+    cntr2_oneshot(uint16_t cnt)
+    {
+        uint8_t val = x86_io::inb(PIT_CNTR2_GATE);
+        val = (val & ~PIT_SPKR_BIT) | PIT_GATE2_BIT;
+        x86_io::outb(PIT_CNTR2_GATE, val);
+
+        x86_io::outb(
+             PIT_CTRL_PORT,
+            (uint8_t)
+            (PIT_SEL_CNTR2   << 6 |
+             PIT_RW_LATCH    << 4 |
+             PIT_MODE_TC     << 1));
+
+        // counting starts once high byte is written
+        x86_io::outb(PIT_CNTR2_PORT, (uint8_t)cnt);
+        x86_io::outb(PIT_CNTR2_PORT, (uint8_t)(cnt>>8));
+    }
+
+    // OUT goes high when counter 2 reaches 0 in mode 0
+    bool
+    cntr2_out()
+    {
+        return (x86_io::inb(PIT_CNTR2_GATE) & PIT_OUT2_BIT) != 0;
+    }
 public:
     static pit8253&
     instance() {
@@ -28,4 +28,50 @@ bit_toggle(T& r, U s) {
     bit_set(r, s, !bit_test(r, s));
 }
 
+// index of the least significant set bit (bsf), 'v' cannot be zero
+template<typename T>
+inline uint32_t
+bit_lsb(T v) {
+    return (uint32_t)__builtin_ctz((uint32_t)v);
+}
+
+// index of the most significant set bit (bsr), 'v' cannot be zero
+template<typename T>
+inline uint32_t
+bit_msb(T v) {
+    return 31 - (uint32_t)__builtin_clz((uint32_t)v);
+}
+
+#ifndef __POPCNT__
+// freestanding builds have no libgcc to provide '__popcountsi2', so
+// population count falls back to a byte table built at compile time.
+struct bit_count_tbl_t
+{
+    uint8_t val[256];
+
+    constexpr bit_count_tbl_t() : val() {
+        for(uint32_t i = 1; i < 256; ++i) {
+            val[i] = (uint8_t)((i & 1) + val[i / 2]);
+        }
+    }
+};
+
+inline constexpr bit_count_tbl_t s_bit_count_tbl;
+#endif
+
+// number of set bits (popcount)
+template<typename T>
+inline uint32_t
+bit_count(T v) {
+#ifdef __POPCNT__
+    return (uint32_t)__builtin_popcount((uint32_t)v);
+#else
+    uint32_t n = 0;
+    for(uint32_t i = 0; i < sizeof(T); ++i) {
+        n += s_bit_count_tbl.val[(uint8_t)((uint32_t)v >> (i * 8))];
+    }
+    return n;
+#endif
+}
+
 ns_lite_kernel_lib_end
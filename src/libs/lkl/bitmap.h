@@ -1,6 +1,7 @@
 #pragma once
 #include <lkl.h>
 #include <debug.h>
+#include <bit.h>
 
 ns_lite_kernel_lib_begin
 template<typename bits_t>
@@ -13,6 +14,8 @@ private:
     uint32_t _limit    = 0;       // bit limit, range (0, _bit_size)
 
 public:
+    typedef bits_t word_t;
+
     enum
     {
         BIT_LENGTH    = sizeof(bits_t) * 8,
@@ -61,6 +64,13 @@ public:
         return _bit_size;
     }
 
+    // raw value of word 'idx'
+    bits_t
+    word(uint32_t idx) const {
+        ASSERT(idx < _buf_size && "error idx value.");
+        return _buf[idx];
+    }
+
     bool
     limit(uint32_t limit) {
         if(limit >= 0 && limit <= bit_size()) {
@@ -86,11 +96,11 @@ public:
     // the units of 'idx' and 'len' are 'bit'
     bool
     test(uint32_t idx, bool val, uint32_t len) {
-        for (uint32_t i = 0; i < len; ++i) {
-            if (test(idx + i, val) == false)
-                return false;
+        if (len == 0) {
+            return true;
         }
-        return true;
+        ASSERT(idx + len <= bit_size() && "error idx value.");
+        return run_length(idx, idx + len, val) >= len;
     }
 
     // set _buf[idx] = val
@@ -103,144 +113,188 @@ public:
     }
 
     // set _buf[idx] -> _buf[idx+len] = val
+    // partial head/tail words are updated through masks, whole words
+    // in between are filled directly.
     void set(uint32_t idx, uint32_t len, bool val) {
-        if (idx >= bit_size()) {
+        if (idx >= bit_size() || len == 0) {
             return;
         }
 
-        if (idx + len > bit_size()) {
+        if (len > bit_size() - idx) {
             len = bit_size() - idx;
         }
 
-        uint32_t end = idx + len;
-        while (idx < end)
-        {
-            if (idx % BIT_LENGTH == 0 && end - idx > BIT_LENGTH)
-            {
-                _buf[idx / BIT_LENGTH] = val ? MAX_VALUE : 0;
-                idx += BIT_LENGTH;
-            }
-            else
-            {
-                set(idx, val);
-                ++idx;
-            }
+        uint32_t end  = idx + len;
+        uint32_t head = idx / BIT_LENGTH;
+        uint32_t tail = (end - 1) / BIT_LENGTH;
+
+        if (head == tail) {
+            fill(head, range_mask(idx % BIT_LENGTH, end - head * BIT_LENGTH),
+                 val);
+            return;
         }
+
+        fill(head, range_mask(idx % BIT_LENGTH, BIT_LENGTH), val);
+        for (uint32_t i = head + 1; i < tail; ++i) {
+            _buf[i] = val ? MAX_VALUE : 0;
+        }
+        fill(tail, range_mask(0, end - tail * BIT_LENGTH), val);
     }
 
     uint32_t count(uint32_t start, uint32_t len, bool val)
     {
-        if(start  >= limit())
+        if(start  >= limit() || len == 0)
             return 0;
 
-        auto end = start+len > limit() ? limit() : start+len;
-        uint32_t n = 0;
-        for(start; start < end; ++start) {
-            if(test(start,val)) {
-                ++n;
-            }
+        auto end  = len > limit() - start ? limit() : start+len;
+        auto head = start / BIT_LENGTH;
+        auto tail = (end - 1) / BIT_LENGTH;
+
+        if(head == tail) {
+            return bit_count(hits_of(head, val) &
+                range_mask(start % BIT_LENGTH, end - head * BIT_LENGTH));
         }
+
+        uint32_t n = bit_count(hits_of(head, val) &
+                     range_mask(start % BIT_LENGTH, BIT_LENGTH));
+        for(auto idx = head + 1; idx < tail; ++idx) {
+            n += bit_count(hits_of(idx, val));
+        }
+        n += bit_count(hits_of(tail, val) &
+             range_mask(0, end - tail * BIT_LENGTH));
         return n;
     }
 
+    // count bits equal 'val' in range [0, limit), counting stops once
+    // 'cnt' reached
     uint32_t count(bool val, uint32_t cnt = 0xFFFF'FFFF)
     {
-        bits_t   full =  val ? MAX_VALUE : 0;
-        bits_t   empt =  ~full; 
-        uint32_t tail =  limit() % BIT_LENGTH;
-        uint32_t rsz  = (limit() + BIT_SUPREMUM) / BIT_LENGTH;
+        if(limit() == 0)
+            return 0;
+
+        uint32_t last = (limit() - 1) / BIT_LENGTH;
         uint32_t num  =  0;
 
-        for(uint32_t idx = 0; idx < rsz; ++idx) {
-            if(_buf[idx] == full) {
-                num += BIT_LENGTH;
-            } else if (_buf[idx] == empt) {
-                continue;
-            } else {
-                num += count(idx*BIT_LENGTH, BIT_LENGTH, val);
-            }
+        for(uint32_t idx = 0; idx < last && num < cnt; ++idx) {
+            num += bit_count(hits_of(idx, val));
+        }
 
-            if(num >= cnt) {
-                return num;
-            }
+        if(num < cnt) {
+            num += bit_count(hits_of(last, val) &
+                   range_mask(0, limit() - last * BIT_LENGTH));
         }
-        num += count(limit() - tail, limit(), val);
         return num;
     }
 
     // find contiguous values in range
+    // whole words are skipped if none of their bits equals 'val', the
+    // first candidate bit is located by 'bsf' and each candidate run is
+    // measured word by word, so the cost is O(words) rather than O(bits).
     uint32_t find(uint32_t start, uint32_t end, bool val, uint32_t len)
     {
         // cannot search beyond '_limit'
         end = end > limit() ? limit() : end;
 
-        while (start < end)
+        if (len == 0) {
+            return INVALID_INDEX;
+        }
+
+        while (start < end && end - start >= len)
         {
-            uint32_t idx = roughly_find(start, end, val);
-            if (idx == INVALID_INDEX) {
+            uint32_t fit = find_first(start, end, val);
+            if (fit == INVALID_INDEX || end - fit < len) {
                 return INVALID_INDEX;
             }
 
-            if (idx * BIT_LENGTH > start) {
-                start = idx * BIT_LENGTH;
+            uint32_t run = run_length(fit, fit + len, val);
+            if (run >= len) {
+                // we found enough bits
+                return fit;
             }
 
-            uint32_t ed  = (idx + 1) * BIT_LENGTH + len;
-                     ed  = ed < end ? ed : end;
-
-            uint32_t fit = INVALID_INDEX;
-            uint32_t n   = 0;
-
-            for (;start < ed; ++start) {
-
-                if (test(start, val)) {
-                    if (fit == INVALID_INDEX) {
-                        fit = start;
-                    }
-                    if (++n == len) {
-                        // we found enough bits
-                        return fit;
-                    }
-                }
-                else if (fit != INVALID_INDEX) {
-                    fit = INVALID_INDEX; // first unfit
-                    n   = 0; // count reset
-                }
-            }
-            start = (idx + 1) * BIT_LENGTH;
+            // bit 'fit + run' doesn't equal 'val', restart behind it
+            start = fit + run + 1;
         }
         return INVALID_INDEX;
     }
 
-protected:
+    // index of the first bit equals 'val' in range [start, end)
+    uint32_t find_first(uint32_t start, uint32_t end, bool val) const
+    {
+        end = end > limit() ? limit() : end;
+        if (start >= end) {
+            return INVALID_INDEX;
+        }
 
-    bits_t
-    bit_mask(uint32_t idx) const {
-        return (bits_t)1 << (idx % BIT_LENGTH);
-    }
+        uint32_t idx  = start / BIT_LENGTH;
+        uint32_t last = (end - 1) / BIT_LENGTH;
 
-    // skip those 0xFFFF/0x0000 to save time
-    uint32_t roughly_find(uint32_t start, uint32_t end, bool val = true) {
-        start /= BIT_LENGTH;
-        end   /= BIT_LENGTH;
-        if(start >= _buf_size) {
-            return INVALID_INDEX;
+        // ignore bits below 'start' in first word
+        bits_t   hits = hits_of(idx, val) &
+                        (bits_t)(MAX_VALUE << (start % BIT_LENGTH));
+
+        while (hits == 0) {
+            if (++idx > last) {
+                return INVALID_INDEX;
+            }
+            hits = hits_of(idx, val);
         }
 
-        // real size
-        uint32_t rsz = (limit() + BIT_SUPREMUM) / BIT_LENGTH;
+        uint32_t pos = idx * BIT_LENGTH + bit_lsb(hits);
+        return pos < end ? pos : INVALID_INDEX;
+    }
+
+    // count contiguous bits equal 'val' starting at 'pos', counting
+    // stops once the run reaches 'cap' (the result might exceed 'cap'
+    // by less than a word)
+    uint32_t run_length(uint32_t pos, uint32_t cap, bool val) const
+    {
+        ASSERT(pos < cap && cap <= bit_size());
 
-        end = end > rsz ? rsz : end;
+        uint32_t idx  = pos / BIT_LENGTH;
+        uint32_t off  = pos % BIT_LENGTH;
 
-        bits_t full = val ? 0 : MAX_VALUE;
+        // bits don't equal 'val', shifted to 'pos'
+        bits_t   miss = (bits_t)((bits_t)~hits_of(idx, val) >> off);
 
-        while (start < end) {
-            if (_buf[start] != full) {
-                return start;
+        if (miss != 0) {
+            return bit_lsb(miss);
+        }
+
+        uint32_t run = BIT_LENGTH - off;
+        while (pos + run < cap) {
+            miss = (bits_t)~hits_of(++idx, val);
+            if (miss != 0) {
+                return run + bit_lsb(miss);
             }
-            ++start;
+            run += BIT_LENGTH;
         }
-        return INVALID_INDEX;
+        return run;
+    }
+
+protected:
+
+    bits_t
+    bit_mask(uint32_t idx) const {
+        return (bits_t)1 << (idx % BIT_LENGTH);
+    }
+
+    // mask of bits [lo, hi) in a word, 0 <= lo < hi <= BIT_LENGTH
+    bits_t
+    range_mask(uint32_t lo, uint32_t hi) const {
+        return (bits_t)((bits_t)MAX_VALUE >> (BIT_LENGTH - (hi - lo))) << lo;
+    }
+
+    // set/clear bits of word 'idx' selected by 'mask'
+    void
+    fill(uint32_t idx, bits_t mask, bool val) {
+        _buf[idx] = val ? _buf[idx] | mask : _buf[idx] & (bits_t)~mask;
+    }
+
+    // word 'idx' with those bits equal 'val' set to 1
+    bits_t
+    hits_of(uint32_t idx, bool val) const {
+        return val ? _buf[idx] : (bits_t)~_buf[idx];
     }
 };
 
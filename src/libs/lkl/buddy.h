@@ -0,0 +1,327 @@
+#pragma once
+#include <lkl.h>
+#include <x86/pg.h>
+#include <bit.h>
+#include <debug.h>
+#include <string.h>
+
+ns_lite_kernel_lib_begin
+
+/*
+ * Binary Buddy Allocator
+ * physical memory is managed as blocks of 2^order pages (order 0-10,
+ * 4KB - 4MB). a block of order 'n' at page index 'i' always satisfies
+ * i % 2^n == 0, so its 'buddy' is simply at i ^ 2^n.
+ *
+ * alloc: take a block from the smallest non-empty free list whose
+ *        order >= wanted order, split it in halves until it fits.
+ *        the upper halves go back to their free lists.
+ * free:  while the buddy is a free block of the same order, take it
+ *        off its list and merge. the merged block goes to free list.
+ *
+ *   order 2  ┌───────────────────────────────┐
+ *            │               0               │
+ *   order 1  ├───────────────┬───────────────┤
+ *            │       0       │       2       │
+ *   order 0  ├───────┬───────┼───────┬───────┤
+ *            │   0   │   1   │   2   │   3   │
+ *            └───────┴───────┴───────┴───────┘
+ *
+ * each page has a small node (6 bytes) in the caller's buffer. nodes
+ * link free blocks of same order into a doubly-linked list by page
+ * index, so both 'pop a free block' and 'take buddy off its list' are
+ * O(1). no node ever lives in the managed memory itself, because
+ * most of physical memory isn't mapped when the pool is in use.
+ */
+class buddy_t
+{
+public:
+    enum
+    {
+        MAX_ORDER     = 10,            // largest block: 1024 pages (4MB)
+        ORDER_COUNT   = MAX_ORDER + 1,
+        MAX_PAGES     = 0xFFFF,        // node links are 16-bit
+        INVALID_INDEX = ~((uint32_t)0)
+    };
+
+private:
+    enum : uint16_t
+    {
+        NIL = 0xFFFF
+    };
+
+    struct bnode_t
+    {
+        uint16_t _prev;  // previous free block of same order
+        uint16_t _next;  // next free block of same order
+        uint8_t  _order; // order of the block starts at this page
+        uint8_t  _free;  // 1 if this page heads a free block
+    };
+
+    bnode_t*  _nodes = nullptr;
+    uint32_t  _size  = 0;  // buffer size by byte
+    uint32_t  _npg   = 0;  // page count
+    uint32_t  _nfp   = 0;  // free page count
+    uint32_t  _base  = 0;  // base address
+    uint16_t  _heads[ORDER_COUNT];
+
+public:
+
+    buddy_t() {
+        for(uint32_t i = 0; i < ORDER_COUNT; ++i) {
+            _heads[i] = NIL;
+        }
+    }
+
+    // buffer size (by byte) needed to manage 'space_size' memory
+    static uint32_t
+    calc_buffer_size(uint32_t space_size) {
+        uint32_t npg = space_size / PAGE_SIZE;
+        npg = npg > MAX_PAGES ? MAX_PAGES : npg;
+        return npg * sizeof(bnode_t);
+    }
+
+    // order of the smallest block holds 'cnt' pages
+    static uint32_t
+    calc_order(uint32_t cnt) {
+        return cnt <= 1 ? 0 : bit_msb(cnt - 1) + 1;
+    }
+
+    uint32_t page_count() const {
+        return _npg;
+    }
+
+    uint32_t free_page_count() const {
+        return _nfp;
+    }
+
+    uint32_t used_page_count() const {
+        return _npg - _nfp;
+    }
+
+    // whether 'addr' is in the managed space
+    bool contains(const void* addr) const {
+        return (uint32_t)addr >= _base &&
+               ((uint32_t)addr - _base) / PAGE_SIZE < _npg;
+    }
+
+    // provide ability to free buffer
+    void*
+    get_buffer() const {
+        return _nodes;
+    }
+
+    // by byte
+    uint32_t
+    buffer_size() const {
+        return _size;
+    }
+
+    void
+    reset(void*     buf,        // buffer address
+          uint32_t  buf_size,   // by byte
+          uint32_t  base,       // base address (4K aligned)
+          uint32_t  space_size) // address space size
+    {
+        ASSERT(is_4k_aligned((void*)base) && "base is not 4K aligned.");
+
+        _nodes = (bnode_t*)buf;
+        _size  = buf_size;
+        _base  = base;
+        _nfp   = 0;
+
+        // page count > node count
+        // buffer cannot describe whole memory area
+        _npg   = space_size / PAGE_SIZE;
+        if(_npg > buf_size / sizeof(bnode_t)) {
+            _npg = buf_size / sizeof(bnode_t);
+        }
+        if(_npg > MAX_PAGES) {
+            _npg = MAX_PAGES;
+        }
+
+        for(uint32_t i = 0; i < ORDER_COUNT; ++i) {
+            _heads[i] = NIL;
+        }
+        memset(_nodes, 0, _npg * sizeof(bnode_t));
+
+        // carve the whole space into largest aligned blocks
+        __inner_free_range(0, _npg);
+        ASSERT(_nfp == _npg);
+    }
+
+    // allocate 'cnt' physically contiguous pages
+    // the block is taken from order calc_order(cnt), the tail it
+    // doesn't need goes back to the pool immediately.
+    void*
+    alloc(uint32_t cnt)
+    {
+        if(cnt == 0 || cnt > _nfp) {
+            return nullptr;
+        }
+
+        uint32_t order = calc_order(cnt);
+        if(order > MAX_ORDER) {
+            return nullptr;
+        }
+
+        uint32_t idx = __inner_alloc_block(order);
+        if(idx == INVALID_INDEX) {
+            return nullptr;
+        }
+
+        __inner_free_range(idx + cnt, (1u << order) - cnt);
+        return (void*)(_base + idx * PAGE_SIZE);
+    }
+
+    // allocate a block of 2^order pages, aligned to its size
+    void*
+    alloc_order(uint32_t order)
+    {
+        if(order > MAX_ORDER) {
+            return nullptr;
+        }
+
+        uint32_t idx = __inner_alloc_block(order);
+        if(idx == INVALID_INDEX) {
+            return nullptr;
+        }
+        return (void*)(_base + idx * PAGE_SIZE);
+    }
+
+    // return 'cnt' pages starting at 'addr' to pool
+    // it doesn't matter how those pages were allocated, any range of
+    // used pages can be freed.
+    void
+    free(void* addr, uint32_t cnt)
+    {
+        // address out of range
+        if((_base > (uint32_t)addr) ||
+           ((uint32_t)addr - _base) / PAGE_SIZE + cnt > _npg)
+        {
+            return;
+        }
+
+        ASSERT((uint32_t)addr % PAGE_SIZE == 0 &&
+               "address is not 4K aligned.");
+
+        __inner_free_range(((uint32_t)addr - _base) / PAGE_SIZE, cnt);
+    }
+
+    // largest order has a free block, -1 if pool is empty
+    int32_t
+    max_free_order() const
+    {
+        for(int32_t order = MAX_ORDER; order >= 0; --order) {
+            if(_heads[order] != NIL) {
+                return order;
+            }
+        }
+        return -1;
+    }
+
+private:
+
+    uint32_t
+    __inner_alloc_block(uint32_t order)
+    {
+        // smallest non-empty list which is big enough
+        uint32_t cur = order;
+        while(cur <= MAX_ORDER && _heads[cur] == NIL) {
+            ++cur;
+        }
+
+        if(cur > MAX_ORDER) {
+            return INVALID_INDEX;
+        }
+
+        uint32_t idx = _heads[cur];
+        __inner_unlink(idx);
+
+        // split, upper halves go back to free lists
+        while(cur > order) {
+            --cur;
+            __inner_push(idx + (1u << cur), cur);
+        }
+
+        _nodes[idx]._order = (uint8_t)order;
+        return idx;
+    }
+
+    void
+    __inner_free_block(uint32_t idx, uint32_t order)
+    {
+        ASSERT(_nodes[idx]._free == 0 && "double free.");
+
+        while(order < MAX_ORDER) {
+            uint32_t bud = idx ^ (1u << order);
+            if(bud + (1u << order) > _npg   ||
+               _nodes[bud]._free  == 0      ||
+               _nodes[bud]._order != order)
+            {
+                break;
+            }
+            __inner_unlink(bud);
+            idx &= ~(1u << order);
+            ++order;
+        }
+        __inner_push(idx, order);
+    }
+
+    // split range [idx, idx+cnt) into aligned blocks and free them
+    void
+    __inner_free_range(uint32_t idx, uint32_t cnt)
+    {
+        while(cnt > 0) {
+            uint32_t order = idx == 0 ? MAX_ORDER : bit_lsb(idx);
+            uint32_t fit   = bit_msb(cnt);
+
+            order = order > MAX_ORDER ? MAX_ORDER : order;
+            order = order > fit       ? fit       : order;
+
+            __inner_free_block(idx, order);
+            idx += 1u << order;
+            cnt -= 1u << order;
+        }
+    }
+
+    void
+    __inner_push(uint32_t idx, uint32_t order)
+    {
+        auto& nd = _nodes[idx];
+        nd._order = (uint8_t)order;
+        nd._free  = 1;
+        nd._prev  = NIL;
+        nd._next  = _heads[order];
+
+        if(_heads[order] != NIL) {
+            _nodes[_heads[order]]._prev = (uint16_t)idx;
+        }
+        _heads[order] = (uint16_t)idx;
+        _nfp += 1u << order;
+    }
+
+    void
+    __inner_unlink(uint32_t idx)
+    {
+        auto& nd = _nodes[idx];
+        ASSERT(nd._free != 0);
+
+        if(nd._prev != NIL) {
+            _nodes[nd._prev]._next = nd._next;
+        } else {
+            _heads[nd._order] = nd._next;
+        }
+
+        if(nd._next != NIL) {
+            _nodes[nd._next]._prev = nd._prev;
+        }
+
+        nd._free = 0;
+        nd._prev = NIL;
+        nd._next = NIL;
+        _nfp -= 1u << nd._order;
+    }
+};
+
+ns_lite_kernel_lib_end
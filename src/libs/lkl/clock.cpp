@@ -0,0 +1,63 @@
+#include <clock.h>
+#include <timer.h>
+#include <pit.h>
+
+ns_lite_kernel_lib_begin
+
+uint64_t clock_mgr::s_base    = 0;
+uint32_t clock_mgr::s_cpms    = 0;
+uint32_t clock_mgr::s_mult    = 0;
+bool     clock_mgr::s_has_tsc = false;
+seqlock_t clock_mgr::s_seq;
+
+void
+clock_mgr::init()
+{
+    if(calibrated() || x86_asm::has_tsc() == false) {
+        return;
+    }
+
+    uint32_t best = 0xFFFF'FFFF;
+    for(uint32_t i = 0; i < CLK_CALI_ROUND; ++i) {
+        uint32_t cyc = __inner_calibrate_once();
+        best = cyc < best ? cyc : best;
+    }
+
+    uint32_t cpms = best / CLK_CALI_MS;
+    ASSERT(cpms != 0);
+    // quotient fits in 32 bits for any cpu faster than 4MHz
+    uint32_t mult = (uint32_t)x86_asm::div64(
+        (uint64_t)NS_PER_MS << CLK_SHIFT,
+        cpms);
+
+    seq_write_guard guard(s_seq);
+    s_cpms    = cpms;
+    s_mult    = mult;
+    s_base    = x86_asm::rdtsc();
+    s_has_tsc = true;
+}
+
+uint64_t
+clock_mgr::now_ns()
+{
+    if(s_has_tsc) {
+        return cycles_to_ns(cycles());
+    }
+    // without TSC, tick resolution is what we have
+    return (uint64_t)timer_mgr::ticks() * (NS_PER_SEC / timer_mgr::freq());
+}
+
+uint32_t
+clock_mgr::__inner_calibrate_once()
+{
+    auto& pit = pit8253::instance();
+    pit.cntr2_oneshot(
+        (uint16_t)((uint32_t)pit8253::PIT_INPUT_FREQ * CLK_CALI_MS / 1000));
+
+    uint64_t beg = x86_asm::rdtsc();
+    while(pit.cntr2_out() == false) {
+    }
+    return (uint32_t)(x86_asm::rdtsc() - beg);
+}
+
+ns_lite_kernel_lib_end
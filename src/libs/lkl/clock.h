@@ -0,0 +1,155 @@
+#pragma once
+#include <lkl.h>
+#include <x86/asm.h>
+#include <seqlock.h>
+
+ns_lite_kernel_lib_begin
+
+// cycle statistics of an instrumented path.
+// not locked, update it where it can't be interrupted by itself.
+struct cycle_stats_t
+{
+    uint32_t count = 0;
+    uint32_t min   = 0xFFFF'FFFF;
+    uint32_t max   = 0;
+    uint64_t total = 0;
+
+    inline void
+    add(uint32_t cyc) {
+        ++count;
+        total += cyc;
+        min = cyc < min ? cyc : min;
+        max = cyc > max ? cyc : max;
+    }
+
+    inline uint32_t
+    avg() const {
+        return count != 0 ? (uint32_t)x86_asm::div64(total, count) : 0;
+    }
+
+    inline void
+    reset() {
+        *this = cycle_stats_t();
+    }
+};
+
+/*
+ * monotonic clock based on time stamp counter.
+ *
+ * 'init' counts TSC cycles while PIT counter 2 runs down a known
+ * number of input clocks, which gives cycles per millisecond. cycles
+ * are turned into nanoseconds by multiply and shift:
+ *     ns = cycles * mult >> CLK_SHIFT
+ * where mult = (NS_PER_MS << CLK_SHIFT) / cycles_per_ms. no 64-bit
+ * division on the fast path.
+ *
+ * TSC is assumed to be constant rate. cpus without TSC fall back to
+ * timer ticks, 'cycles' returns 0 then.
+ *
+ * 's_base' is 64-bit and takes two loads on i386, calibration data is
+ * read under 's_seq' so a reader never sees half of an update.
+ */
+class clock_mgr
+{
+public:
+    enum
+    {
+        CLK_SHIFT      = 24,
+        CLK_CALI_MS    = 10,    // each calibration round lasts 10ms
+        CLK_CALI_ROUND = 3,     // best of 3, an SMI only makes it longer
+        NS_PER_US      = 1000,
+        NS_PER_MS      = 1000'000,
+        NS_PER_SEC     = 1000'000'000
+    };
+private:
+    static uint64_t s_base;     // TSC at calibration
+    static uint32_t s_cpms;     // cycles per millisecond
+    static uint32_t s_mult;
+    static bool     s_has_tsc;
+    static seqlock_t s_seq;
+public:
+    // calibrate TSC, call it once with interrupt off before any
+    // measurement. it takes CLK_CALI_MS * CLK_CALI_ROUND ms.
+    static void
+    init();
+
+    static inline bool
+    calibrated() {
+        return s_cpms != 0;
+    }
+
+    // cycles since calibration
+    static inline uint64_t
+    cycles() {
+        if(s_has_tsc == false) {
+            return 0;
+        }
+
+        uint32_t seq;
+        uint64_t base;
+        do {
+            seq  = s_seq.read_begin();
+            base = s_base;
+        } while(s_seq.read_retry(seq));
+        return x86_asm::rdtsc() - base;
+    }
+
+    static inline uint32_t
+    cycles_per_ms() {
+        return s_cpms;
+    }
+
+    static inline uint64_t
+    cycles_to_ns(uint64_t cyc) {
+        uint32_t seq;
+        uint32_t mult;
+        do {
+            seq  = s_seq.read_begin();
+            mult = s_mult;
+        } while(s_seq.read_retry(seq));
+
+        // split 'cyc' so that neither product overflows
+        uint64_t hi = (cyc >> 32) * mult;
+        uint64_t lo = (cyc & 0xFFFF'FFFF) * mult;
+        return (hi << (32 - CLK_SHIFT)) + (lo >> CLK_SHIFT);
+    }
+
+    // nanoseconds since calibration
+    static uint64_t
+    now_ns();
+
+    static inline uint64_t
+    now_us() {
+        return x86_asm::div64(now_ns(), NS_PER_US);
+    }
+
+private:
+    // cycles counted in one calibration round
+    static uint32_t
+    __inner_calibrate_once();
+
+    // creating an instance is disallowed
+    clock_mgr() = delete;
+};
+
+// adds cycles spent in its scope to a 'cycle_stats_t'
+class scoped_timer
+{
+    cycle_stats_t& _stats;
+    uint64_t       _beg;
+public:
+    explicit scoped_timer(cycle_stats_t& stats)
+        : _stats(stats),
+          _beg(clock_mgr::cycles()) {
+    }
+
+    ~scoped_timer() {
+        _stats.add((uint32_t)(clock_mgr::cycles() - _beg));
+    }
+
+    // non-assignable
+    scoped_timer(scoped_timer const&) = delete;
+    scoped_timer& operator=(scoped_timer const&) = delete;
+};
+
+ns_lite_kernel_lib_end
@@ -0,0 +1,38 @@
+#include <condvar.h>
+#include <lock.h>
+#include <tskmgr.h>
+
+ns_lite_kernel_lib_begin
+
+void
+condvar_t::wait(lock_t& lk)
+{
+    ASSERT(lk.holder() == task_mgr::current_thread());
+    uint32_t seq = _seq;
+    {
+        intr_guard guard(false);
+        lk.release();
+        if(_seq == seq) {
+            _waitq.sleep();
+        }
+    }
+    lk.acquire();
+}
+
+void
+condvar_t::notify_one()
+{
+    intr_guard guard(false);
+    ++_seq;
+    _waitq.notify_one();
+}
+
+void
+condvar_t::notify_all()
+{
+    intr_guard guard(false);
+    ++_seq;
+    _waitq.notify_all();
+}
+
+ns_lite_kernel_lib_end
@@ -0,0 +1,46 @@
+#pragma once
+#include <lkl.h>
+#include <waitq.h>
+
+ns_lite_kernel_lib_begin
+
+class lock_t;
+
+/*
+ * condition variable paired with a 'lock_t'.
+ *
+ * 'wait' releases the lock and sleeps, then takes the lock again
+ * before it returns. releasing the lock may switch to a waiter of it,
+ * so we can't be queued by then. instead '_seq' is read while the lock
+ * is still held and every notify bumps it: if it moved before we are
+ * queued (with interrupt off), a notify was missed and we don't sleep.
+ *
+ * wake ups might be spurious, use the 'pred' version or check again.
+ * lock must be held exactly once (not recursively) by the waiter.
+ */
+class condvar_t
+{
+private:
+    wait_queue_t _waitq;
+    uint32_t     _seq = 0;
+public:
+    void
+    wait(lock_t& lk);
+
+    template<typename Pred>
+    void
+    wait(lock_t& lk, Pred pred) {
+        while(pred() == false) {
+            wait(lk);
+        }
+    }
+
+    void
+    notify_one();
+
+    // all waiters are moved to ready queue at once
+    void
+    notify_all();
+};
+
+ns_lite_kernel_lib_end
@@ -0,0 +1,278 @@
+#pragma once
+#include <lkl.h>
+#include <debug.h>
+#include <bit.h>
+#include <bitmap.h>
+
+ns_lite_kernel_lib_begin
+
+/*
+ * Hierarchical Bitmap
+ * 'bitmap_t' has to look at words one by one from 'start' to find a
+ * candidate. the more pages a pool used, the longer it takes. 
+ * 'hbitmap_t' keeps two levels of summary on top of the bitmap:
+ *
+ * level 0: caller's buffer, 1 bit per page. (same as bitmap_t)
+ * level 1: 1 bit per level 0 word (32 pages), the bit is set if the
+ *          word has any bit equals 'val'. there's one level 1 map for
+ *          each 'val', so both 'has free' and 'has used' are known.
+ * level 2: 1 bit per level 1 word (1024 pages), the bit is set if the
+ *          level 1 word isn't zero.
+ *
+ *                        ┌────────────────────────────────┐
+ * level 2                │ 1 0 1 ...                      │ 1 word
+ *                        └─┬───┬──────────────────────────┘
+ *                 ┌────────┘   └───────┐
+ * level 1   ┌─────┴──────────┐   ┌─────┴──────────┐
+ *           │ 0 0 1 0 ...    │   │ 1 0 0 0 ...    │     32 words max
+ *           └─────┬──────────┘   └─┬──────────────┘
+ * level 0         └─> word 2       └─> word 64            1024 words max
+ *
+ * locating first candidate word costs 3 'bsf' at most. every update
+ * to level 0 refreshes the summaries of touched words.
+ *
+ * 'max_words' cannot exceed 1024 (32 * 32), 1024 words = 32768 bits,
+ * that's exactly one page of bitmap buffer, which maps 128 MB.
+ */
+template<uint32_t max_words = 1024>
+class hbitmap_t
+{
+public:
+    typedef uint32_t word_t;
+
+    enum
+    {
+        BIT_LENGTH    = bitmap_t<word_t>::BIT_LENGTH,
+        INVALID_INDEX = bitmap_t<word_t>::INVALID_INDEX,
+        L1_WORDS      = (max_words + BIT_LENGTH - 1) / BIT_LENGTH
+    };
+
+    static_assert(L1_WORDS <= BIT_LENGTH, "level 2 must fit in a word");
+
+private:
+    bitmap_t<word_t> _bmp;                    // level 0
+    bitmap_t<word_t> _l1[2];                  // level 1, index by 'val'
+    word_t           _l1_buf[2][L1_WORDS] = {};
+    word_t           _l2[2]               = {}; // level 2, index by 'val'
+
+public:
+    // default constructor
+    hbitmap_t() = default;
+
+    // summaries point into the object itself
+    hbitmap_t(const hbitmap_t&)            = delete;
+    hbitmap_t& operator=(const hbitmap_t&) = delete;
+
+    // words beyond 'max_words' are ignored
+    void*
+    reset(word_t* buf, uint32_t len) {
+        len = len > max_words ? max_words : len;
+
+        auto tmp = _bmp.reset(buf, len);
+        _l1[0].reset(_l1_buf[0], L1_WORDS);
+        _l1[1].reset(_l1_buf[1], L1_WORDS);
+        _l1[0].set(0, _l1[0].bit_size(), false);
+        _l1[1].set(0, _l1[1].bit_size(), false);
+        _l2[0] = 0;
+        _l2[1] = 0;
+        __inner_refresh(0, len);
+        return tmp;
+    }
+
+    void*
+    get_buffer() const {
+        return _bmp.get_buffer();
+    }
+
+    // get buffer size
+    uint32_t
+    buffer_size() const {
+        return _bmp.buffer_size();
+    }
+
+    uint32_t
+    bit_size() const {
+        return _bmp.bit_size();
+    }
+
+    bool
+    limit(uint32_t limit) {
+        if(_bmp.limit(limit)) {
+            // bits beyond limit never count in summaries
+            __inner_refresh(0, _bmp.buffer_size());
+            return true;
+        }
+        return false;
+    }
+
+    uint32_t
+    limit() const {
+        return _bmp.limit();
+    }
+
+    bool
+    test(uint32_t idx, bool val = true) const {
+        return _bmp.test(idx, val);
+    }
+
+    bool
+    test(uint32_t idx, bool val, uint32_t len) {
+        return _bmp.test(idx, val, len);
+    }
+
+    void
+    set(uint32_t idx, bool val) {
+        _bmp.set(idx, val);
+        if(idx < bit_size()) {
+            __inner_refresh(idx / BIT_LENGTH, idx / BIT_LENGTH + 1);
+        }
+    }
+
+    void
+    set(uint32_t idx, uint32_t len, bool val) {
+        if(idx >= bit_size() || len == 0) {
+            return;
+        }
+
+        if(len > bit_size() - idx) {
+            len = bit_size() - idx;
+        }
+
+        _bmp.set(idx, len, val);
+        __inner_refresh(
+            idx / BIT_LENGTH,
+            (idx + len - 1) / BIT_LENGTH + 1);
+    }
+
+    uint32_t
+    count(uint32_t start, uint32_t len, bool val) {
+        return _bmp.count(start, len, val);
+    }
+
+    uint32_t
+    count(bool val, uint32_t cnt = 0xFFFF'FFFF) {
+        return _bmp.count(val, cnt);
+    }
+
+    // find contiguous values in range
+    // same as 'bitmap_t::find' but candidates come from summaries
+    uint32_t
+    find(uint32_t start, uint32_t end, bool val, uint32_t len)
+    {
+        end = end > limit() ? limit() : end;
+
+        if(len == 0) {
+            return INVALID_INDEX;
+        }
+
+        while(start < end && end - start >= len)
+        {
+            uint32_t fit = find_first(start, end, val);
+            if(fit == INVALID_INDEX || end - fit < len) {
+                return INVALID_INDEX;
+            }
+
+            uint32_t run = _bmp.run_length(fit, fit + len, val);
+            if(run >= len) {
+                return fit;
+            }
+            start = fit + run + 1;
+        }
+        return INVALID_INDEX;
+    }
+
+    // index of the first bit equals 'val' in range [start, end)
+    uint32_t
+    find_first(uint32_t start, uint32_t end, bool val) const
+    {
+        end = end > limit() ? limit() : end;
+        if(start >= end) {
+            return INVALID_INDEX;
+        }
+
+        // first word might be partially below 'start'
+        uint32_t idx = start / BIT_LENGTH;
+        uint32_t nxt = (idx + 1) * BIT_LENGTH;
+        uint32_t pos = _bmp.find_first(start, nxt < end ? nxt : end, val);
+
+        if(pos != INVALID_INDEX || nxt >= end) {
+            return pos;
+        }
+
+        idx = __inner_next_word(idx + 1, val);
+        if(idx == INVALID_INDEX || idx * BIT_LENGTH >= end) {
+            return INVALID_INDEX;
+        }
+
+        nxt = (idx + 1) * BIT_LENGTH;
+        return _bmp.find_first(idx * BIT_LENGTH, nxt < end ? nxt : end, val);
+    }
+
+protected:
+
+    // first level 0 word (index >= 'from') has any bit equals 'val'
+    uint32_t
+    __inner_next_word(uint32_t from, bool val) const
+    {
+        if(from >= _bmp.buffer_size()) {
+            return INVALID_INDEX;
+        }
+
+        uint32_t grp  = from / BIT_LENGTH;
+        word_t   bits = _l1_buf[val][grp] &
+                        ((word_t)~0u << (from % BIT_LENGTH));
+
+        if(bits == 0) {
+            // look for next non-zero level 1 word in level 2
+            word_t up = grp + 1 < BIT_LENGTH ?
+                        _l2[val] & ((word_t)~0u << (grp + 1)) :
+                        0;
+            if(up == 0) {
+                return INVALID_INDEX;
+            }
+            grp  = bit_lsb(up);
+            bits = _l1_buf[val][grp];
+        }
+        return grp * BIT_LENGTH + bit_lsb(bits);
+    }
+
+    // recalculate summaries of level 0 words [first, last)
+    void
+    __inner_refresh(uint32_t first, uint32_t last)
+    {
+        for(uint32_t idx = first; idx < last; ++idx) {
+            word_t wd = _bmp.word(idx);
+            word_t vm = __inner_valid_mask(idx);
+            _l1[1].set(idx, (wd & vm) != 0);
+            _l1[0].set(idx, ((word_t)~wd & vm) != 0);
+        }
+
+        if(first >= last) {
+            return;
+        }
+
+        for(uint32_t grp  = first / BIT_LENGTH;
+                     grp <= (last - 1) / BIT_LENGTH;
+                     ++grp)
+        {
+            bit_set(_l2[0], (word_t)1 << grp, _l1_buf[0][grp] != 0);
+            bit_set(_l2[1], (word_t)1 << grp, _l1_buf[1][grp] != 0);
+        }
+    }
+
+    // bits of word 'idx' lie below limit
+    word_t
+    __inner_valid_mask(uint32_t idx) const
+    {
+        uint32_t base = idx * BIT_LENGTH;
+        if(base >= limit()) {
+            return 0;
+        }
+        if(limit() - base >= BIT_LENGTH) {
+            return (word_t)~0u;
+        }
+        return ((word_t)1 << (limit() - base)) - 1;
+    }
+};
+
+ns_lite_kernel_lib_end
@@ -0,0 +1,257 @@
+#pragma once
+#include <lkl.h>
+#include <debug.h>
+
+ns_lite_kernel_lib_begin
+
+template<typename T, typename Less> class heap_t;
+
+// node of 'heap_t', embedded in the object like 'qnode_t'.
+template<typename T>
+class hnode_t {
+
+    template<typename, typename> friend class heap_t;
+protected:
+    hnode_t* _child  = nullptr;  // leftmost child
+    hnode_t* _next   = nullptr;  // right sibling
+    hnode_t* _prev   = nullptr;  // left sibling, or parent if leftmost
+    T*       _pobj;
+    bool     _linked = false;
+public:
+    hnode_t() { }
+    hnode_t(T* pobj) : _pobj(pobj) { }
+
+    bool alone() const {
+        return _linked == false;
+    }
+
+    T* get() const noexcept {
+        return _pobj;
+    }
+
+    void reset(T* pobj) {
+        _pobj = pobj;
+    }
+
+    T* operator->() const noexcept {
+        ASSERT(_pobj != nullptr);
+        return _pobj;
+    }
+};
+
+// default order of 'heap_t', by 'T::operator<'
+template<typename T>
+struct heap_less
+{
+    bool operator()(const T* a, const T* b) const {
+        return *a < *b;
+    }
+};
+
+/*
+ * intrusive pairing heap, smallest object on top as 'Less' says.
+ *
+ * push is O(1), pop and remove are O(log n) amortized. nothing is
+ * allocated, nodes live in objects, so it's fine in interrupt context
+ * as long as the caller keeps others out. objects of equal order come
+ * out in no particular order.
+ *
+ * all members zero means an empty heap.
+ */
+template<typename T, typename Less = heap_less<T>>
+class heap_t {
+public:
+    typedef hnode_t<T> node;
+
+private:
+    node*    _root = nullptr;
+    uint32_t _size = 0;
+
+public:
+    bool empty() const {
+        return _root == nullptr;
+    }
+
+    uint32_t size() const {
+        return _size;
+    }
+
+    node* top() {
+        return _root;
+    }
+
+    const node* top() const {
+        return _root;
+    }
+
+    void push(node* nd) {
+        if (nd == nullptr || nd->alone() == false) {
+            return;
+        }
+
+        nd->_child  = nullptr;
+        nd->_next   = nullptr;
+        nd->_prev   = nullptr;
+        nd->_linked = true;
+        _root = _root != nullptr ? __inner_meld(_root, nd) : nd;
+        ++_size;
+    }
+
+    node* pop() {
+        if (empty()) {
+            return nullptr;
+        }
+
+        node* nd = _root;
+        _root = __inner_merge_pairs(nd->_child);
+        __inner_leave(nd);
+        return nd;
+    }
+
+    // take 'nd' out wherever it is, nothing happens if it's in no heap
+    void remove(node* nd) {
+        if (nd == nullptr || nd->alone()) {
+            return;
+        }
+
+        if (nd == _root) {
+            pop();
+            return;
+        }
+
+        // unlink from its siblings, a non-root node always has '_prev'
+        if (nd->_prev->_child == nd) {
+            nd->_prev->_child = nd->_next;
+        } else {
+            nd->_prev->_next = nd->_next;
+        }
+        if (nd->_next != nullptr) {
+            nd->_next->_prev = nd->_prev;
+        }
+
+        node* sub = __inner_merge_pairs(nd->_child);
+        if (sub != nullptr) {
+            _root = __inner_meld(_root, sub);
+        }
+        __inner_leave(nd);
+    }
+
+    // walk the whole heap, check links, order and size.
+    // O(n), meant for ASSERTs and tests. no recursion, a pairing heap
+    // can be as deep as it's large.
+    bool valid() const {
+        if (_root == nullptr) {
+            return _size == 0;
+        }
+        if (_root->_prev != nullptr || _root->_next != nullptr) {
+            return false;
+        }
+
+        uint32_t    cnt = 0;
+        const node* nd  = _root;
+        while (nd != nullptr) {
+            ++cnt;
+            if (nd->_linked == false) {
+                return false;
+            }
+
+            // children are linked back and none is before its parent
+            const node* prev = nd;
+            for (auto c = nd->_child; c != nullptr; c = c->_next) {
+                if (c->_prev != prev || Less()(c->get(), nd->get())) {
+                    return false;
+                }
+                prev = c;
+            }
+
+            // preorder: down, right, or up until there's a right
+            if (nd->_child != nullptr) {
+                nd = nd->_child;
+                continue;
+            }
+            while (nd != nullptr && nd->_next == nullptr) {
+                nd = __inner_parent(nd);
+            }
+            if (nd != nullptr) {
+                nd = nd->_next;
+            }
+        }
+        return cnt == _size;
+    }
+
+private:
+    // '_prev' of the leftmost sibling is the parent
+    static const node* __inner_parent(const node* nd) {
+        while (nd->_prev != nullptr && nd->_prev->_child != nd) {
+            nd = nd->_prev;
+        }
+        return nd->_prev;
+    }
+
+    void __inner_leave(node* nd) {
+        nd->_child  = nullptr;
+        nd->_next   = nullptr;
+        nd->_prev   = nullptr;
+        nd->_linked = false;
+        --_size;
+    }
+
+    // 'a' and 'b' are roots without siblings, return the new root
+    static node* __inner_meld(node* a, node* b) {
+        if (Less()(b->get(), a->get())) {
+            node* tmp = a;
+            a = b;
+            b = tmp;
+        }
+
+        b->_prev = a;
+        b->_next = a->_child;
+        if (a->_child != nullptr) {
+            a->_child->_prev = b;
+        }
+        a->_child = b;
+        return a;
+    }
+
+    // two-pass pairing of a sibling list: meld pairs left to right,
+    // then meld the results right to left.
+    static node* __inner_merge_pairs(node* first) {
+        if (first == nullptr) {
+            return nullptr;
+        }
+
+        // results of first pass, reversed, linked by '_next'
+        node* list = nullptr;
+        while (first != nullptr) {
+            node* a = first;
+            node* b = a->_next;
+            a->_prev = nullptr;
+            if (b == nullptr) {
+                a->_next = list;
+                list     = a;
+                break;
+            }
+
+            first = b->_next;
+            a->_next = nullptr;
+            b->_next = nullptr;
+            b->_prev = nullptr;
+            node* m  = __inner_meld(a, b);
+            m->_next = list;
+            list     = m;
+        }
+
+        node* res = list;
+        list      = list->_next;
+        res->_next = nullptr;
+        while (list != nullptr) {
+            node* nxt   = list->_next;
+            list->_next = nullptr;
+            res  = __inner_meld(res, list);
+            list = nxt;
+        }
+        return res;
+    }
+};
+
+ns_lite_kernel_lib_end
@@ -1,14 +1,16 @@
 #pragma once
 #include <lkl.h>
-#include <lock.h>
+#include <ring.h>
+#include <waitq.h>
 #include <scode.h>
 
 
 ns_lite_kernel_lib_begin
 
-class thread_t;
-
 // interrupt bounded-buffer
+// one producer (an ISR or softirq) and one consumer thread share a
+// lock-free ring. threads only queue up when the ring is empty or
+// full, that's the only place interrupt is turned off.
 class inbb_t
 {
     enum
@@ -16,39 +18,37 @@ class inbb_t
         BUF_SIZE = 128
     };
 private:
-    lock_t      _lock;
-    scode_t     _buf[BUF_SIZE];
-    int32_t     _head           = 0;
-    int32_t     _tail           = 0;
-    thread_t*   _producer       = nullptr;
-    thread_t*   _consumer       = nullptr;
+    spsc_ring<scode_t, BUF_SIZE> _ring;
+    // threads waiting for the ring to become non-empty/non-full
+    wait_queue_t                 _getters;
+    wait_queue_t                 _putters;
 public:
-    inline int32_t
-    next(int32_t pos) const {
-        return (pos + 1) % BUF_SIZE;
-    }
-
     inline bool
     full() const {
-        return next(_head) == _tail;
+        return _ring.full();
     };
 
     inline bool
     empty() const {
-        return _head == _tail;
+        return _ring.empty();
     }
 
+    // never blocks, for interrupt context.
+    // return false if buffer is full, 'c' is dropped.
+    bool
+    try_putc(scode_t c);
+
+    // blocks while buffer is full, threads only.
     void
     putc(scode_t c);
 
+    // never blocks, return false if buffer is empty.
+    bool
+    try_getc(scode_t& c);
+
+    // blocks while buffer is empty.
     scode_t
     getc();
-
-    void
-    wait(bool who);
-
-    void
-    signal(bool producer);
 };
 
-ns_lite_kernel_lib_end
\ No newline at end of file
+ns_lite_kernel_lib_end
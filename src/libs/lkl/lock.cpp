@@ -1,31 +1,183 @@
 #include <lock.h>
 #include <tskmgr.h>
+#include <thread.h>
+#include <intmgr.h>
 
 ns_lite_kernel_lib_begin
 
 void
 lock_t::acquire()
 {
-    if(_holder != task_mgr::current_thread()) {
-        _sema.down();
-        _holder   = task_mgr::current_thread();
-        _lock_cnt = 1;
+    auto cur = task_mgr::current_thread();
+    if(holder() == cur) {
+        ++_lock_cnt;
+        return;
+    }
 
-    } else {
+    if(__inner_cas(0, (uint32_t)cur) == false) {
+        __inner_acquire_slow(cur);
+    }
+    _lock_cnt = 1;
+}
+
+bool
+lock_t::try_acquire()
+{
+    auto cur = task_mgr::current_thread();
+    if(holder() == cur) {
         ++_lock_cnt;
+        return true;
     }
+
+    if(__inner_cas(0, (uint32_t)cur)) {
+        _lock_cnt = 1;
+        return true;
+    }
+    return false;
 }
 
 void
 lock_t::release()
 {
-    if(_lock_cnt > 1) {
-        --_lock_cnt;
-    } else {
-        _holder   = nullptr;
-        _lock_cnt = 0;
-        _sema.up();
+    auto cur = task_mgr::current_thread();
+    ASSERT(holder() == cur && _lock_cnt > 0);
+
+    if(--_lock_cnt > 0) {
+        return;
+    }
+
+    if(__inner_cas((uint32_t)cur, 0) == false) {
+        __inner_release_slow(cur);
+    }
+}
+
+void
+lock_t::__inner_acquire_slow(thread_t* cur)
+{
+    // spin while holder is running, it can only be on another cpu
+    for(uint32_t i = 0; i < LOCK_SPIN_MAX; ++i) {
+        auto th = holder();
+        if(th == nullptr) {
+            if(__inner_cas(0, (uint32_t)cur)) {
+                return;
+            }
+            continue;
+        }
+        if(th->is_running() == false) {
+            break;
+        }
+        x86_asm::cpu_relax();
+    }
+
+    intr_guard guard(false);
+    while(true) {
+        uint32_t st = __atomic_load_n(&_state, __ATOMIC_RELAXED);
+        if(st == 0) {
+            if(__inner_cas(0, (uint32_t)cur)) {
+                return;
+            }
+            continue;
+        }
+
+        // tell holder to take the slow path on release
+        if((st & LOCK_WAITERS) != 0 || __inner_cas(st, st | LOCK_WAITERS)) {
+            break;
+        }
+    }
+
+    // holder is pointed by '_state', it can't go away while we are
+    // here with interrupt off.
+    // a lock with waiters is in its holder's '_held' and nowhere else
+    auto th = holder();
+    if(_hnode.alone()) {
+        th->_held.push_back(&_hnode);
+    }
+    ASSERT(th->_held.find(&_hnode));
+
+    _waiters.push_back(cur->node_ptr());
+    cur->_blocked_on = this;
+    __inner_boost(cur->eff_prior());
+    task_mgr::block_current_thread();
+
+    // lock was handed over
+    cur->_blocked_on = nullptr;
+    ASSERT(holder() == cur);
+}
+
+void
+lock_t::__inner_release_slow(thread_t* cur)
+{
+    intr_guard guard(false);
+
+    // waiter of highest priority, first come first served on a tie
+    auto node = _waiters.head();
+    ASSERT(node != nullptr);
+    for(auto itr = node->next(); itr != nullptr; itr = itr->next()) {
+        if((*itr)->eff_prior() > (*node)->eff_prior()) {
+            node = itr;
+        }
+    }
+    auto next = node->get();
+    _waiters.remove(node);
+
+    // lock moves from our '_held' to next holder's
+    cur->_held.remove(&_hnode);
+    uint32_t st = (uint32_t)next;
+    if(_waiters.empty() == false) {
+        st |= LOCK_WAITERS;
+        next->_held.push_back(&_hnode);
+    }
+    __atomic_store_n(&_state, st, __ATOMIC_RELEASE);
+
+    // next holder inherits from rest of the waiters
+    uint32_t top = __inner_top_waiter_prior();
+    if(top > next->eff_prior()) {
+        task_mgr::set_eff_prior(next, top);
+    }
+    task_mgr::unblock_thread(next);
+
+    // drop the boost this lock gave us
+    task_mgr::set_eff_prior(cur, __inner_calc_prior(cur));
+    task_mgr::resched();
+}
+
+uint32_t
+lock_t::__inner_top_waiter_prior() const
+{
+    uint32_t pr = 0;
+    for(auto th : _waiters) {
+        if(th->eff_prior() > pr) {
+            pr = th->eff_prior();
+        }
+    }
+    return pr;
+}
+
+void
+lock_t::__inner_boost(uint32_t pr)
+{
+    lock_t* lk = this;
+    for(uint32_t i = 0; lk != nullptr && i < LOCK_PI_DEPTH; ++i) {
+        auto th = lk->holder();
+        if(th == nullptr || th->eff_prior() >= pr) {
+            break;
+        }
+        task_mgr::set_eff_prior(th, pr);
+        lk = th->_blocked_on;
+    }
+}
+
+uint32_t
+lock_t::__inner_calc_prior(thread_t* th)
+{
+    uint32_t pr = th->base_prior();
+    for(auto lk : th->_held) {
+        uint32_t top = lk->__inner_top_waiter_prior();
+        if(top > pr) {
+            pr = top;
+        }
     }
+    return pr;
 }
 
-ns_lite_kernel_lib_end
\ No newline at end of file
+ns_lite_kernel_lib_end
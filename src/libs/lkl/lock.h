@@ -1,28 +1,93 @@
 #pragma once
 #include <lkl.h>
-#include <semaphore.h>
+#include <queue.h>
 
 ns_lite_kernel_lib_begin
 
 class thread_t;
 
+/*
+ * adaptive mutex, recursive.
+ *
+ * '_state' holds the holder (thread_t is page aligned, low bits are
+ * free) and LOCK_WAITERS. taking a free lock or releasing one nobody
+ * waits for is a single CAS, no interrupt toggling, no queue.
+ *
+ * a contender spins a little while the holder is running on another
+ * cpu, it's likely to be out soon. otherwise (always, with one cpu)
+ * it queues up and blocks. release hands the lock over to the waiter
+ * of highest priority directly, so a thread woken up already owns it
+ * and nobody can barge in.
+ *
+ * PRIORITY INHERITANCE:
+ * a blocking waiter raises effective priority of the holder to its
+ * own, and of the holder's holder if the holder is blocked on another
+ * lock, and so on. a lock with waiters is in its holder's '_held'
+ * queue, release drops it from there and recomputes the holder's
+ * priority from its base and the waiters of locks it still holds.
+ */
 class lock_t
 {
+    enum : uint32_t
+    {
+        LOCK_WAITERS   = 0x0000'0001,
+        LOCK_FLAGS     = 0x0000'0001,
+        LOCK_SPIN_MAX  = 100,
+        LOCK_PI_DEPTH  = 16     // a longer chain is likely a deadlock
+    };
 private:
-    thread_t*   _holder   = nullptr;
-    uint32_t    _lock_cnt = 0;
-    semaphore_t _sema;
+    uint32_t          _state    = 0;
+    uint32_t          _lock_cnt = 0;
+    queue_t<thread_t> _waiters;
+    // node in holder's '_held' queue
+    qnode_t<lock_t>   _hnode;
     
 public:
-    lock_t() 
-    : _sema(1) {
+    lock_t()
+    : _hnode(this) {
     }
 
     void
     acquire();
 
+    // return false if another thread holds it
+    bool
+    try_acquire();
+
     void
     release();
+
+    thread_t*
+    holder() const {
+        return (thread_t*)(__atomic_load_n(&_state, __ATOMIC_RELAXED) &
+                           ~LOCK_FLAGS);
+    }
+
+private:
+    inline bool
+    __inner_cas(uint32_t exp, uint32_t val) {
+        return __atomic_compare_exchange_n(
+            &_state, &exp, val, false,
+            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    }
+
+    void
+    __inner_acquire_slow(thread_t* cur);
+
+    void
+    __inner_release_slow(thread_t* cur);
+
+    // highest effective priority among waiters, 0 if none
+    uint32_t
+    __inner_top_waiter_prior() const;
+
+    // boost holders along the chain starting at this lock
+    void
+    __inner_boost(uint32_t pr);
+
+    // base priority of 'th' or highest waiter of locks it holds
+    static uint32_t
+    __inner_calc_prior(thread_t* th);
 };
 
 class lock_guard
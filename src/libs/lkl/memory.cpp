@@ -1,6 +1,11 @@
 #include <memory.h>
 #include <ards.h>
+#include <x86/asm.h>
 #include <string.h>
+#include <intmgr.h>
+#include <timer.h>
+#include <tskmgr.h>
+#include <softirq.h>
 
 ns_lite_kernel_lib_begin
 
@@ -8,9 +13,11 @@ ns_lite_kernel_lib_begin
 
 //---------------------------------------------------------------------------
 // Memory Manager
-pool_t mem_mgr::_kp_pool;
-pool_t mem_mgr::_kv_pool;
+buddy_t mem_mgr::_kp_pool;
+hpool_t mem_mgr::_kv_pool;
 lock_t mem_mgr::_lock;
+uint32_t mem_mgr::_committed = 0;
+mem_mgr::pf_stats_t mem_mgr::_pf_stats;
 void mem_mgr::init()
 {
     lock_guard al(_lock);
@@ -29,8 +36,11 @@ void mem_mgr::init()
      * mem_mgr already has 'ARDS' information, 0x0800 - 0x9F000 can 
      * be reused.
      * 
-     * kernel needs at least 4 pools:
-     * kernel physical memory pool: 0x0800 - 0x1800
+     * kernel physical memory is managed by a buddy allocator, each
+     * page has a 6-byte node:
+     * kernel physical memory nodes: 0x10000 - 0x40000 (192KB)
+     * 
+     * the other pools are bitmaps:
      * kernel virtual address pool: 0x1800 - 0x2800
      * user   physical memory pool: 0x2800 - 0x3800
      * user   virtual address pool: 0x3800 - 0x4800
@@ -45,22 +55,24 @@ void mem_mgr::init()
     uint32_t mem_size   = phsy_size/2;
     uint32_t start_addr = phys_addr;
 
-    memset((void*)KER_P_BMP_BUF, 0, 0x1000);
+    // first 16MB has been identity-mapped in 'enable_paging' and first
+    // 1MB doesn't count in kernel pool, it's a different memory
+    // segment.
+    // (4096-256) = 3840 = 0xF00
+    // 3840 * 4K  = 15MB
+    // those pages never go back to kernel pool, so the buddy allocator
+    // simply starts after them. 
+    const uint32_t rsvd = 0xF00 * PAGE_SIZE;
+    ASSERT(mem_size > rsvd && "not enough physical memory!");
 
     _kp_pool.reset(
-        (void*)KER_P_BMP_BUF, // bitmap buffer (physical address)
-        PAGE_SIZE,            // bitmap buffer size (1 page)
-        start_addr,           // physical memory starting address
-        mem_size              // physical memory size
+        (void*)KER_P_BDY_BUF, // buddy node buffer (physical address)
+        KER_P_BDY_LEN,        // buddy node buffer size
+        start_addr + rsvd,    // physical memory starting address
+        mem_size   - rsvd     // physical memory size
     );
 
-    // tell _kp_pool that first 16MB has been identity-mapped in 
-    // 'enable_paging' and first 1MB doesn't count in kernel pool,
-    // it's a different memory segment.
-    // (4096-256) = 3840 = 0xF00
-    // 3840 * 4K  = 15MB
-    auto addr = _kp_pool.alloc(0xF00);
-    ASSERT((uint32_t)addr == start_addr);
+    memset((void*)KER_V_BMP_BUF, 0, 0x1000);
     
     _kv_pool.reset(
         (void*)KER_V_BMP_BUF, // bitmap buffer
@@ -69,8 +81,10 @@ void mem_mgr::init()
         mem_size              // same as physical memory size
     );
 
-    addr = _kv_pool.alloc(0x1000);
+    auto addr = _kv_pool.alloc(0x1000);
     ASSERT((uint32_t)addr == KER_V_ADDR_START);
+
+    intr_mgr::instance().reg(intr_mgr::IRQ_NAME_PF, on_page_fault);
 }
 
 void* mem_mgr::alloc(page_type_t pt, uint32_t cnt)
@@ -88,6 +102,24 @@ void* mem_mgr::alloc(page_type_t pt, uint32_t cnt)
     return nullptr;
 }
 
+void
+mem_mgr::free(page_type_t pt, void* addr, uint32_t cnt)
+{
+    if(addr == nullptr || cnt == 0)
+        return;
+
+    ASSERT(is_4k_aligned(addr) && "address is not 4K aligned.");
+
+    lock_guard al(_lock);
+
+    if(pt == PT_KERNEL) {
+        __inner_unmap_pages(_kp_pool, (uint32_t)addr, cnt);
+        _kv_pool.free(addr, cnt);
+    } else {
+        // free user memory
+    }
+}
+
 void*
 mem_mgr::alloc_phys_page(uint32_t cnt)
 {
@@ -95,14 +127,121 @@ mem_mgr::alloc_phys_page(uint32_t cnt)
         return nullptr;
 
     lock_guard al(_lock);
+    if(__inner_free_kp_count() < cnt) {
+        return nullptr;
+    }
     return _kp_pool.alloc(cnt);
 }
 
-static uint32_t
-v2p(uint32_t addr)
+void*
+mem_mgr::reserve(page_type_t pt, uint32_t cnt)
+{
+    if(cnt == 0)
+        return nullptr;
+
+    lock_guard al(_lock);
+
+    if(pt != PT_KERNEL) {
+        // user memory isn't managed yet
+        return nullptr;
+    }
+
+    uint32_t vaddr = (uint32_t)_kv_pool.alloc(cnt);
+    if(vaddr == 0) {
+        return nullptr;
+    }
+
+    // every page and the page tables for them must be there when
+    // they're touched
+    uint32_t pgs = __inner_detect_unallocated_pte(
+        vaddr,
+        vaddr + (cnt - 1) * PAGE_SIZE);
+    if(__inner_free_kp_count() < cnt + pgs) {
+        _kv_pool.free((void*)vaddr, cnt);
+        return nullptr;
+    }
+
+    if(__inner_mark_lazy(vaddr, cnt) == false) {
+        // clears marks made so far and page tables made for them
+        __inner_unmap_pages(_kp_pool, vaddr, cnt);
+        _kv_pool.free((void*)vaddr, cnt);
+        return nullptr;
+    }
+    return (void*)vaddr;
+}
+
+void
+mem_mgr::on_page_fault(uint32_t vct)
 {
-    pte_t pte = addr;
-    return pte.address() + (addr&pte.MASK_LO_12BITS);
+    // read cr2 first, handling this fault may cause another one
+    uint32_t vaddr = x86_asm::get_cr2();
+    uint32_t err   = intr_mgr::err_code();
+    uint64_t beg   = clock_mgr::cycles();
+
+    if(__inner_do_page_fault(vaddr, err) == false) {
+        dbg_mhl("page fault at:", vaddr);
+        dbg_mhl(" error code:", err);
+        dbg_ln();
+        PANIC("unhandled page fault");
+    }
+
+    ++_pf_stats.faults;
+    _pf_stats.cycles.add((uint32_t)(clock_mgr::cycles() - beg));
+}
+
+uint32_t
+mem_mgr::pf_rate()
+{
+    uint32_t ticks = timer_mgr::ticks() - _pf_stats.since;
+    if(ticks == 0) {
+        return 0;
+    }
+    return (uint32_t)x86_asm::div64(
+        (uint64_t)_pf_stats.faults * timer_mgr::freq(),
+        ticks);
+}
+
+void
+mem_mgr::reset_pf_stats()
+{
+    intr_guard guard(false);
+    _pf_stats       = pf_stats_t();
+    _pf_stats.since = timer_mgr::ticks();
+}
+
+bool
+mem_mgr::map_contig(uint32_t vaddr, uint32_t paddr, uint32_t cnt)
+{
+    ASSERT(is_4k_aligned((void*)vaddr) && is_4k_aligned((void*)paddr));
+    lock_guard al(_lock);
+    return __inner_map_pages(vaddr, paddr, nullptr, cnt);
+}
+
+bool
+mem_mgr::map_range(uint32_t vaddr, const uint32_t* paddr, uint32_t cnt)
+{
+    ASSERT(is_4k_aligned((void*)vaddr) && paddr != nullptr);
+    lock_guard al(_lock);
+    return __inner_map_pages(vaddr, 0, paddr, cnt);
+}
+
+uint32_t
+mem_mgr::v2p(uint32_t addr)
+{
+    auto pde = __inner_get_pde_v(addr);
+    if(pde->present() == false) {
+        return 0;
+    }
+
+    if(pde->ps()) {
+        return pde->large_address() + (addr & ~MASK_H10_BITS);
+    }
+
+    auto pte = __inner_get_pte_v(addr);
+    if(pte->present() == false) {
+        return 0;
+    }
+    return pte->address() + (addr & pte_t::MASK_LO_12BITS);
 }
 
 uint32_t mem_mgr::__inner_detect_unallocated_pte(
@@ -123,33 +262,285 @@ uint32_t mem_mgr::__inner_detect_unallocated_pte(
     return num;
 }
 
-void mem_mgr::__inner_map_virtual_on_phys(
-    uint32_t vaddr,
-    uint32_t paddr)
+pte_t*
+mem_mgr::__inner_get_or_make_pte_v(uint32_t vaddr)
 {
     auto pde = __inner_get_pde_v(vaddr);
+    // a PDE with PS set maps a 4MB page directly, writing PTEs would
+    // scribble over that page.
+    if(pde->present() && pde->ps()) {
+        return nullptr;
+    }
     if(pde->present() == false) {
-        // always use kernel pool to allocate PTE memory
+        // always use kernel pool to allocate PTE memory, pages
+        // committed to reserved ones are not ours to take
+        if(__inner_free_kp_count() == 0) {
+            return nullptr;
+        }
         auto pg = _kp_pool.alloc(1);
-        ASSERT(pg != 0 && "error: cannot allocate physical memory");
-        memset(pg, 0, PAGE_SIZE);
+        if(pg == nullptr) {
+            return nullptr;
+        }
+        pde->zeroize();
         pde->address((uint32_t)pg);
         pde->present(true);
         pde->writable(true);
-        // note: cannot use physical address (pg) to access pte directly
+        // cannot use physical address (pg) to access page table, it
+        // might not be mapped. clear it through the self-mapped PDE.
+        memset(__inner_get_pte_v(vaddr & PTE_RANGE_MASK), 0, PAGE_SIZE);
     }
+    return __inner_get_pte_v(vaddr);
+}
+
+bool
+mem_mgr::__inner_map_pages(
+    uint32_t        vaddr,
+    uint32_t        pbase,
+    const uint32_t* paddr,
+    uint32_t        cnt)
+{
+    // kernel mappings are global, they don't change across address
+    // spaces.
+    pte_t ent;
+    ent.present(true);
+    ent.writable(true);
+    ent.global(vaddr >= KER_V_ADDR_START);
+    const uint32_t flags = ent;
+
+    // PDE lookup once per page table, then fill consecutive PTEs
+    while(cnt > 0) {
+        auto pte = __inner_get_or_make_pte_v(vaddr);
+        if(pte == nullptr) {
+            return false;
+        }
+
+        // entries left in this page table
+        uint32_t num = PT_ENT_NUM - calc_pte_index((void*)vaddr);
+        num = num > cnt ? cnt : num;
+
+        if(paddr != nullptr) {
+            for(uint32_t i = 0; i < num; ++i) {
+                pte[i] = (paddr[i] & MASK_H20_BITS) | flags;
+            }
+            paddr += num;
+        } else {
+            for(uint32_t i = 0; i < num; ++i) {
+                pte[i] = pbase | flags;
+                pbase += PAGE_SIZE;
+            }
+        }
+
+        vaddr += num * PAGE_SIZE;
+        cnt   -= num;
+    }
+    return true;
+}
+
+void
+mem_mgr::__inner_unmap_pages(
+    buddy_t& mpool,
+    uint32_t vaddr,
+    uint32_t cnt)
+{
+    // physically contiguous pages are given back as one run
+    uint32_t run_beg = 0;
+    uint32_t run_len = 0;
+    bool     flush   = cnt > INVLPG_MAX;
+
+    uint32_t addr = vaddr;
+    uint32_t left = cnt;
+    while(left > 0) {
+        uint32_t num = PT_ENT_NUM - calc_pte_index((void*)addr);
+        num = num > left ? left : num;
+
+        // 4MB pages are never unmapped here
+        auto pde = __inner_get_pde_v(addr);
+        if(pde->present() && pde->ps() == false) {
+            auto pte = __inner_get_pte_v(addr);
+            for(uint32_t i = 0; i < num; ++i) {
+                if(pte[i].present() == false) {
+                    // reserved but never touched
+                    if(pte[i] == PTE_LAZY) {
+                        --_committed;
+                    }
+                    pte[i].zeroize();
+                    continue;
+                }
+
+                uint32_t paddr = pte[i].address();
+                pte[i].zeroize();
+                if(flush == false) {
+                    x86_asm::invlpg(addr + i * PAGE_SIZE);
+                }
+
+                if(run_len > 0 && paddr == run_beg + run_len * PAGE_SIZE) {
+                    ++run_len;
+                    continue;
+                }
+                if(run_len > 0) {
+                    mpool.free((void*)run_beg, run_len);
+                }
+                run_beg = paddr;
+                run_len = 1;
+            }
+
+            if(__inner_release_pt(addr)) {
+                flush = true;
+            }
+        }
+
+        addr += num * PAGE_SIZE;
+        left -= num;
+    }
+
+    if(run_len > 0) {
+        mpool.free((void*)run_beg, run_len);
+    }
+
+    // a single flush drops all stale entries at once, kernel pages
+    // are global and a cr3 reload doesn't touch them.
+    if(flush) {
+        if(vaddr >= KER_V_ADDR_START) {
+            x86_asm::flush_global();
+        } else {
+            x86_asm::flush_tlb();
+        }
+    }
+}
+
+bool
+mem_mgr::__inner_make_pts(uint32_t vaddr, uint32_t cnt)
+{
+    while(cnt > 0) {
+        if(__inner_get_or_make_pte_v(vaddr) == nullptr) {
+            return false;
+        }
+
+        uint32_t num = PT_ENT_NUM - calc_pte_index((void*)vaddr);
+        num = num > cnt ? cnt : num;
+        vaddr += num * PAGE_SIZE;
+        cnt   -= num;
+    }
+    return true;
+}
+
+bool
+mem_mgr::__inner_mark_lazy(uint32_t vaddr, uint32_t cnt)
+{
+    while(cnt > 0) {
+        auto pte = __inner_get_or_make_pte_v(vaddr);
+        if(pte == nullptr) {
+            return false;
+        }
+
+        uint32_t num = PT_ENT_NUM - calc_pte_index((void*)vaddr);
+        num = num > cnt ? cnt : num;
+        for(uint32_t i = 0; i < num; ++i) {
+            ASSERT(pte[i] == 0 && "reserving a page in use.");
+            pte[i] = PTE_LAZY;
+            ++_committed;
+        }
+
+        vaddr += num * PAGE_SIZE;
+        cnt   -= num;
+    }
+    return true;
+}
+
+bool
+mem_mgr::__inner_do_page_fault(uint32_t vaddr, uint32_t err)
+{
+    // access violation on a present page is a bug, not ours to fix
+    if((err & PF_ERR_P) != 0) {
+        return false;
+    }
+
+    auto pde = __inner_get_pde_v(vaddr);
+    if(pde->present() == false || pde->ps()) {
+        return false;
+    }
+
+    // not a reserved page, nothing to do with '_lock'
     auto pte = __inner_get_pte_v(vaddr);
-    pte->present(true);
-    pte->address(paddr);
-    pte->present(true);
+    if(pte->present() == false && *pte != PTE_LAZY) {
+        return false;
+    }
+
+    // taking '_lock' may block, which is only fine for a thread that
+    // faulted with interrupt on and doesn't hold '_lock' already.
+    // anything else breaks 'reserve's contract, don't deadlock on it.
+    if(intr_mgr::intr_was_on() == false) {
+        PANIC("reserved page touched with interrupt off.");
+    }
+    // a drain is never switched out and an ISR runs with interrupt
+    // off, so with interrupt on this means the fault came from a work
+    // item, not from another thread the drain was preempted by.
+    if(softirq_mgr::running()) {
+        PANIC("reserved page touched in softirq.");
+    }
+    if(_lock.holder() == task_mgr::current_thread()) {
+        PANIC("reserved page touched under mem_mgr lock.");
+    }
+
+    lock_guard al(_lock);
+
+    // another thread touched it while we were waiting for '_lock'
+    if(pte->present()) {
+        return true;
+    }
+    if(*pte != PTE_LAZY) {
+        return false;
+    }
+
+    // the page was committed by 'reserve', it's there
+    auto pg = _kp_pool.alloc(1);
+    ASSERT(_committed > 0);
+    if(pg == nullptr) {
+        return false;
+    }
+    --_committed;
+
+    // page table is there, mapping can't fail. a non-present entry is
+    // never cached in TLB, nothing to invalidate.
+    uint32_t page = vaddr & MASK_H20_BITS;
+    __inner_map_pages(page, (uint32_t)pg, nullptr, 1);
+    memset((void*)page, 0, PAGE_SIZE);
+    return true;
+}
+
+bool
+mem_mgr::__inner_release_pt(uint32_t vaddr)
+{
+    auto pte = __inner_get_pte_v(vaddr & PTE_RANGE_MASK);
+    for(uint32_t i = 0; i < PT_ENT_NUM; ++i) {
+        if(pte[i] != 0) {
+            return false;
+        }
+    }
+
+    // page tables are always allocated from kernel pool, the ones
+    // built by loader are out of pool's range and never released.
+    auto pde = __inner_get_pde_v(vaddr);
+    uint32_t pt_addr = pde->address();
+    if(_kp_pool.contains((void*)pt_addr) == false) {
+        return false;
+    }
+
+    pde->zeroize();
+    _kp_pool.free((void*)pt_addr, 1);
+    return true;
 }
 
 void* mem_mgr::__inner_alloc_pages(
-    pool_t& mpool,
-    pool_t& vpool,
+    buddy_t& mpool,
+    hpool_t& vpool,
     uint32_t cnt)
 {
     uint32_t vaddr = (uint32_t)vpool.alloc(cnt);
+
+    if(vaddr == 0) {
+        return nullptr;
+    }
     
     uint32_t pgs   = 
     __inner_detect_unallocated_pte(
@@ -159,14 +550,14 @@ void* mem_mgr::__inner_alloc_pages(
 
     if(&mpool == &_kp_pool) {
         // allocating kernel memory
-        if(_kp_pool.free_page_count() < cnt + pgs) {
+        if(__inner_free_kp_count() < cnt + pgs) {
             // not enough memory to allocate
             vpool.free((void*)vaddr, cnt);
             return nullptr;
         }
     } else {
         // allocating user memroy
-        if(_kp_pool.free_page_count() < pgs ||
+        if(__inner_free_kp_count()    < pgs ||
            mpool.free_page_count()    < cnt) 
         {
             vpool.free((void*)vaddr, cnt);
@@ -174,11 +565,44 @@ void* mem_mgr::__inner_alloc_pages(
         }
     }
 
-    // physical address
-    uint32_t paddr = 0; 
-    for(uint32_t idx = 0; idx < cnt; ++idx) {
-        paddr = (uint32_t)mpool.alloc(1);
-        __inner_map_virtual_on_phys(vaddr, paddr);
+    // page tables go first, a physical run once taken always gets
+    // mapped. on failure everything mapped so far goes back, runs to
+    // 'mpool' and page tables made for them to '_kp_pool'.
+    if(__inner_make_pts(vaddr, cnt) == false) {
+        __inner_unmap_pages(mpool, vaddr, cnt);
+        vpool.free((void*)vaddr, cnt);
+        return nullptr;
+    }
+
+    // physical pages are taken as one contiguous run if the pool has
+    // a block large enough, otherwise in largest blocks it can offer.
+    // each run is mapped by a single pass over the page tables.
+    uint32_t addr  = vaddr;
+    uint32_t left  = cnt;
+    while(left > 0) {
+        int32_t  mfo   = mpool.max_free_order();
+        uint32_t run   = left;
+        uint32_t paddr = 0;
+        if(mfo >= 0 && buddy_t::calc_order(left) <= (uint32_t)mfo) {
+            paddr = (uint32_t)mpool.alloc(left);
+        } else if(mfo >= 0) {
+            run   = 1u << mfo;
+            paddr = (uint32_t)mpool.alloc_order(mfo);
+        }
+
+        // not expected after the precheck, never hand out a half mapped
+        // range though
+        if(paddr == 0) {
+            __inner_unmap_pages(mpool, vaddr, cnt);
+            vpool.free((void*)vaddr, cnt);
+            return nullptr;
+        }
+
+        // page tables are all there, mapping can't fail
+        __inner_map_pages(addr, paddr, nullptr, run);
+
+        addr += run * PAGE_SIZE;
+        left -= run;
     }
     return (void*)vaddr;
 }
@@ -3,8 +3,10 @@
 #include <x86/pg.h>
 #include <bitmap.h>
 #include <pool.h>
+#include <buddy.h>
 #include <string.h>
 #include <lock.h>
+#include <clock.h>
 
 /*
  * Real Mode Address Space (less than 1 MByte)
@@ -133,22 +135,46 @@ ns_lite_kernel_lib_begin
 class mem_mgr
 {
 private:
-    static pool_t _kp_pool;
-    static pool_t _kv_pool;
+    static buddy_t _kp_pool;
+    static hpool_t _kv_pool;
     static lock_t _lock;
+    // reserved pages not touched yet. '_kp_pool' keeps that many pages
+    // free for them, so a first touch never runs out of memory.
+    static uint32_t _committed;
 private:
     enum
     {
-        KER_P_BMP_BUF    = 0x0800,
         KER_V_BMP_BUF    = 0x1800,
         USR_P_BMP_BUF    = 0x2800,
         USR_V_BMP_BUF    = 0x3800,
+        KER_P_BDY_BUF    = 0x0001'0000, // kernel buddy nodes
+        KER_P_BDY_LEN    = 0x0003'0000, // 32768 nodes, 128MB
         KER_V_ADDR_START = 0xC000'0000, // kernel starting virtual addr
         USR_V_ADDR_START = 0x0100'0000, // user starting virtual addr
         PTE_BOUNDARY     = 0x0040'0000, // each PTE maps 4MB
         PTE_RANGE_MASK   = ~(0x0040'0000-1),
+        // freeing more pages than this reloads cr3 instead of
+        // invalidating pages one by one.
+        INVLPG_MAX       = 32,
+        // a reserved page not touched yet: not present, bit 9 (ignored
+        // by CPU) set. page fault handler maps it.
+        PTE_LAZY         = 0x0000'0200,
+        // page fault error code
+        PF_ERR_P         = 0x01, // protection violation, page present
+        PF_ERR_W         = 0x02, // caused by a write
+        PF_ERR_U         = 0x04, // caused in user mode
     };
 public:
+    // demand paging statistics
+    struct pf_stats_t
+    {
+        uint32_t      faults = 0; // lazy pages mapped
+        uint32_t      since  = 0; // tick of last reset
+        cycle_stats_t cycles;     // time spent in handler
+    };
+private:
+    static pf_stats_t _pf_stats;
+public:
 
     enum page_type_t
     {
@@ -165,9 +191,59 @@ public:
     static void*
     alloc(page_type_t pt, uint32_t cnt);
 
+    // 'free' unmaps 'cnt' pages starting at 'addr', physical pages and
+    // virtual pages go back to their pools. page tables become empty
+    // are released as well.
+    static void
+    free(page_type_t pt, void* addr, uint32_t cnt);
+
     static void*
     alloc_phys_page(uint32_t cnt);
 
+    // 'reserve' allocates virtual pages only. a physical page is
+    // allocated, zeroed and mapped when its virtual page is touched
+    // first time. physical pages are committed though, it fails if
+    // they can't all be backed and other allocations leave them be.
+    // 'free' them like 'alloc'ed pages.
+    // page fault takes '_lock' and may block. a reserved page must be
+    // touched first by a thread with interrupt on, not in a softirq
+    // and not while holding '_lock'. the handler PANICs otherwise.
+    // return 'nullptr' if failed.
+    static void*
+    reserve(page_type_t pt, uint32_t cnt);
+
+    // handler of page fault (vector 0x0E), registered by 'init'.
+    // faults out of reserved pages are fatal.
+    static void
+    on_page_fault(uint32_t vct);
+
+    static inline const pf_stats_t&
+    pf_stats() {
+        return _pf_stats;
+    }
+
+    // page faults per second since last reset
+    static uint32_t
+    pf_rate();
+
+    static void
+    reset_pf_stats();
+
+    // map 'cnt' virtual pages starting at 'vaddr' on physically
+    // contiguous pages starting at 'paddr'.
+    // return false if a page table cannot be allocated or the range
+    // runs into a 4MB page.
+    static bool
+    map_contig(uint32_t vaddr, uint32_t paddr, uint32_t cnt);
+
+    // map 'cnt' virtual pages starting at 'vaddr', page 'i' on
+    // physical page 'paddr[i]'.
+    static bool
+    map_range(uint32_t vaddr, const uint32_t* paddr, uint32_t cnt);
+
+    // physical address of virtual address 'addr', both 4KB pages and
+    // 4MB pages are handled.
+    // return 0 if 'addr' is not mapped.
     static uint32_t
     v2p(uint32_t addr);
 
@@ -188,6 +264,7 @@ private:
         (calc_pde_index((void*)vaddr) << 2));
     }
 
+    // only valid if PDE of 'vaddr' points to a page table
     static inline pte_t*
     __inner_get_pte_v(uint32_t vaddr) {
         return (pte_t*)(MASK_H10_BITS + // point to PDE:1023
@@ -195,15 +272,58 @@ private:
         (calc_pte_index((void*)vaddr) << 2)); // real PTE offset
     }
 
-    static inline void
-    __inner_map_virtual_on_phys(
+    // PTE of 'vaddr', page table is allocated if it's not present.
+    // nullptr if failed or 'vaddr' is in a 4MB page, which has no page
+    // table.
+    static pte_t*
+    __inner_get_or_make_pte_v(uint32_t vaddr);
+
+    // 'paddr' != nullptr: page 'i' maps on 'paddr[i]'
+    // 'paddr' == nullptr: pages map on 'pbase' contiguously
+    static bool
+    __inner_map_pages(
+        uint32_t        vaddr,
+        uint32_t        pbase,
+        const uint32_t* paddr,
+        uint32_t        cnt);
+
+    // unmap pages and return physical pages to 'mpool'
+    static void
+    __inner_unmap_pages(
+        buddy_t& mpool,
         uint32_t vaddr,
-        uint32_t paddr);
+        uint32_t cnt);
+
+    // make sure page tables for 'cnt' pages starting at 'vaddr' are
+    // there. return false if one cannot be allocated or the range runs
+    // into a 4MB page, tables made so far are left in place.
+    static bool
+    __inner_make_pts(uint32_t vaddr, uint32_t cnt);
+
+    // mark 'cnt' pages starting at 'vaddr' as PTE_LAZY, page tables
+    // are allocated as needed. return false if one cannot be.
+    static bool
+    __inner_mark_lazy(uint32_t vaddr, uint32_t cnt);
+
+    // map page of 'vaddr' if it's reserved, false if it's not
+    static bool
+    __inner_do_page_fault(uint32_t vaddr, uint32_t err);
+
+    // free pages of '_kp_pool' not committed to reserved pages
+    static inline uint32_t
+    __inner_free_kp_count() {
+        uint32_t cnt = _kp_pool.free_page_count();
+        return cnt > _committed ? cnt - _committed : 0;
+    }
+
+    // release page table of 'vaddr' if all of its entries are clear
+    static bool
+    __inner_release_pt(uint32_t vaddr);
 
     static void*
     __inner_alloc_pages(
-        pool_t&  mpool,
-        pool_t&  vpool,
+        buddy_t& mpool,
+        hpool_t& vpool,
         uint32_t cnt);
 
     // len = 0 if failed
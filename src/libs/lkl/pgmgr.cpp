@@ -3,9 +3,8 @@
 #include <ards.h>
 
 ns_lite_kernel_lib_begin
-/* each bit maps 4K memory.
- * 4K = 4096 bytes * 8 = 32768 bits
- * 32768 bits * 4K = 128 MB
+/* physical pages are managed by buddy allocators, each page has a
+ * 6-byte node. 128 MB = 32768 pages needs 48 pages of nodes.
  * 
  * 'boot.bin' stored ARDS' information at 0x800
  * 
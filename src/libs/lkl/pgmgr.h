@@ -1,7 +1,7 @@
 #pragma once
 #include <lkl.h>
 #include <lock.h>
-#include <pool.h>
+#include <buddy.h>
 #include <x86/pg.h>
 
 ns_lite_kernel_lib_begin
@@ -11,13 +11,12 @@ class pg_mgr
 private:
     // kernel physical 
     lock_t   _lock;
-    pool_t   _k_pool;
-    pool_t   _u_pool;
+    buddy_t  _k_pool;
+    buddy_t  _u_pool;
     bool     _inited : 1 = false;
     enum
     {
         ST_INITIALIZED = 1,
-        PAGE_MAP_RANGE = 0x8000000, // 128 MB
     };
 public:
     enum pgt_t
@@ -83,9 +82,10 @@ private:
     __inner_detect_valid_mem(
         uint32_t& addr,
         uint32_t& len);
+    // pages of buddy nodes needed to manage 'len' memory
     static uint32_t
     __inner_calc_pages_for_buffer(uint32_t len) {
-        return (len+PAGE_MAP_RANGE-1)/PAGE_MAP_RANGE;   
+        return (buddy_t::calc_buffer_size(len)+PAGE_SIZE-1)/PAGE_SIZE;   
     }
     // static uint32_t
     // __inner_make_addr_4K_aligned(uint32_t addr) {
@@ -2,26 +2,34 @@
 #include <lkl.h>
 #include <x86/pg.h>
 #include <bitmap.h>
+#include <hbitmap.h>
+#include <clock.h>
 
 
 ns_lite_kernel_lib_begin
 
-class pool_t
+// 'bmp_t' decides how free pages are searched, it can be 'bitmap_t'
+// (linear word scan) or 'hbitmap_t' (summary-guided).
+template<typename bmp_t>
+class basic_pool_t
 {
 private:
-    bitmap_t<uint8_t> _bmp;
-    uint32_t          _base;
-    uint32_t          _nfp; // free page count
+    typedef typename bmp_t::word_t word_t;
+
+    bmp_t              _bmp;
+    uint32_t           _base;
+    uint32_t           _nfp; // free page count
+    cycle_stats_t      _alloc_stats;
 public:
 
-    pool_t()
+    basic_pool_t()
         : _base(0),
           _nfp(0)
     {
 
     }
 
-    pool_t(void*     buf,
+    basic_pool_t(void*     buf,
            uint32_t  size,
            uint32_t  addr,
            uint32_t  len)
@@ -47,9 +55,10 @@ public:
         return _bmp.get_buffer();
     }
 
+    // by byte
     uint32_t
     buffer_size() const {
-        return _bmp.buffer_size();
+        return _bmp.buffer_size() * sizeof(word_t);
     }
 
     void
@@ -58,8 +67,12 @@ public:
           uint32_t  base,       // base address
           uint32_t  space_size) // address space size
     {
+        // set bitmap buffer
+        // tail bytes which cannot fill a word are dropped
+        _bmp.reset((word_t*)buf, buf_size / sizeof(word_t));
+
         // bit count
-        uint32_t nbits = buf_size * _bmp.BIT_LENGTH;
+        uint32_t nbits = _bmp.bit_size();
         
         // free page count
         _nfp  = space_size / PAGE_SIZE;
@@ -70,9 +83,6 @@ public:
             _nfp = nbits;
         }
 
-        // set bitmap buffer
-        _bmp.reset((uint8_t*)buf, buf_size);
-
         // cut extra buf off to prevent bitmap from looking into
         // invalid bits.
         // fill invalid bits with 1
@@ -86,8 +96,14 @@ public:
         _base = base;
     }
     
+    // cycles spent in 'alloc', caller's lock keeps it consistent
+    const cycle_stats_t& alloc_stats() const {
+        return _alloc_stats;
+    }
+
     void* alloc(uint32_t cnt)
     {
+        scoped_timer st(_alloc_stats);
         if(cnt <= _nfp) {
             uint32_t idx = _bmp.find(0, _bmp.limit(), false, cnt);
             if(idx != _bmp.INVALID_INDEX) {
@@ -104,7 +120,7 @@ public:
     {
         // address out of range
         if((_base > (uint32_t)addr) ||
-           (_base + _bmp.limit() * PAGE_SIZE < (uint32_t)addr))
+           ((uint32_t)addr - _base) / PAGE_SIZE + cnt > _bmp.limit())
         {
             return;
         }
@@ -118,9 +134,13 @@ public:
                "cheap validity checking");
 
         _bmp.set(idx, cnt, false);
+        _nfp += cnt;
     }
 
 };
 
+using pool_t  = basic_pool_t<bitmap_t<uint32_t>>;
+using hpool_t = basic_pool_t<hbitmap_t<>>;
+
 
 ns_lite_kernel_lib_end
\ No newline at end of file
@@ -16,9 +16,12 @@ protected:
     // In order to prevent '_prev/_next' be modified from outside which 
     // can cause 'queue_t' failed to manage nodes, we put them in 'protected'
     // modifier and make 'queue_t' as a friend to limit access for outsiders.
-    qnode_t* _prev = nullptr;
-    qnode_t* _next = nullptr;
+    qnode_t* _prev   = nullptr;
+    qnode_t* _next   = nullptr;
     T*       _pobj;
+    // true while linked into a queue, a lone queued node has null links
+    // so links alone can't tell.
+    bool     _queued = false;
 public:
     qnode_t() { }
     qnode_t(T* pobj) : _pobj(pobj) { }
@@ -43,13 +46,13 @@ public:
     }
 
     bool alone() const {
-        return _prev == nullptr &&
-               _next == nullptr;
+        return _queued == false;
     }
 
     void leave() {
-        _prev = nullptr;
-        _next = nullptr;
+        _prev   = nullptr;
+        _next   = nullptr;
+        _queued = false;
     }
 
     T* get() const noexcept {
@@ -75,14 +78,54 @@ public:
     }
 };
 
+/*
+ * intrusive doubly linked queue.
+ *
+ * head's '_prev' and tail's '_next' are null, so walking with
+ * 'next()/prev()' stops at the ends. every operation is O(1) except
+ * 'find', which walks the queue and is meant for ASSERTs.
+ *
+ * a node doesn't know which queue it's in, only whether it's in one.
+ * 'remove/insert' trust the caller and check membership in debug
+ * builds only. removing a node that's in no queue does nothing.
+ *
+ * all members zero means an empty queue, so a queue in memset memory
+ * (a TCB) is ready to use.
+ */
 template<typename T>
 class queue_t {
 public:
     typedef qnode_t<T> node;
 
+    // iterates objects from head to tail. don't remove the current
+    // node while iterating, take 'next()' first and walk by hand.
+    template<typename N>
+    class iter_t {
+        N* _nd;
+    public:
+        explicit iter_t(N* nd) : _nd(nd) { }
+
+        T* operator*() const {
+            return _nd->get();
+        }
+
+        iter_t& operator++() {
+            _nd = _nd->next();
+            return *this;
+        }
+
+        bool operator!=(const iter_t& other) const {
+            return _nd != other._nd;
+        }
+    };
+
+    typedef iter_t<node>       iterator;
+    typedef iter_t<const node> const_iterator;
+
 private:
-    node* _head = nullptr;
-    node* _tail = nullptr;
+    node*    _head = nullptr;
+    node*    _tail = nullptr;
+    uint32_t _size = 0;
 
 public:
     node* head() {
@@ -102,33 +145,50 @@ public:
     }
 
     bool unique() const {
-        return _head != nullptr && _head == _tail;
+        return _size == 1;
     }
 
     bool empty() const {
-        return _head == nullptr && _tail == _head;
+        return _size == 0;
+    }
+
+    uint32_t size() const {
+        return _size;
+    }
+
+    iterator begin() {
+        return iterator(_head);
+    }
+
+    iterator end() {
+        return iterator(nullptr);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(_head);
+    }
+
+    const_iterator end() const {
+        return const_iterator(nullptr);
     }
 
     void push_front(node* nd) 
     {
-        if (nd == nullptr ||
-            nd->alone() == false || // only alone node can push into queue
-            (unique() && nd == _head)) {
+        // only alone node can push into queue
+        if (nd == nullptr || nd->alone() == false) {
             return;
         }
 
-        if (empty()) {
-            _head = nd;
+        nd->_prev   = nullptr;
+        nd->_next   = _head;
+        nd->_queued = true;
+        if (_head != nullptr) {
+            _head->_prev = nd;
+        } else {
             _tail = nd;
         }
-        else {
-            node* tmp = unique() ? _tail : _head;
-
-            _head = nd;
-            nd->_next = tmp;
-            nd->_prev = nullptr;
-            tmp->_prev = nd;
-        }
+        _head = nd;
+        ++_size;
     }
 
     node* pop_front()
@@ -137,49 +197,29 @@ public:
             // no ASSERT yet, should throw exception or do something similar
             return nullptr;
         }
-        else if (unique()) {
-            // there's only one node to pop
-            node* tmp = _head;
-            _head = nullptr;
-            _tail = nullptr;
-            tmp->leave();
-            return tmp;
-        } else {
-            node* tmp = _head;
 
-            // only one node will be left
-            if (_head->_next == _tail) {
-                _head = _tail;
-                _head->_next = nullptr;
-                _head->_prev = nullptr;
-            }
-            else {
-                _head = _head->_next;
-                _head->_prev = nullptr;
-            }
-            tmp->leave();
-            return tmp;
-        }
+        node* tmp = _head;
+        __inner_unlink(tmp);
+        return tmp;
     }
 
     void push_back(node* nd) 
     {
-        if (nd == nullptr ||
-            nd->alone() == false || // only alone node can push into queue
-            (unique() && nd == _head)) {
+        // only alone node can push into queue
+        if (nd == nullptr || nd->alone() == false) {
             return;
         }
 
-        if (empty()) {
-            // no matter which way we push if queue_t is empty.
-            push_front(nd);
+        nd->_prev   = _tail;
+        nd->_next   = nullptr;
+        nd->_queued = true;
+        if (_tail != nullptr) {
+            _tail->_next = nd;
         } else {
-            node* tmp = unique() ? _head : _tail;
-            _tail = nd;
-            nd->_prev = tmp;
-            nd->_next = nullptr;
-            tmp->_next = nd;
+            _head = nd;
         }
+        _tail = nd;
+        ++_size;
     }
 
     node* pop_back()
@@ -187,39 +227,22 @@ public:
         if (empty()) {
             return nullptr;
         }
-        else if (unique()) {
-            return pop_front();
-        } else {
-            node* tmp = _tail;
-            if (_head->_next == _tail) {
-                _tail = _head;
-                _tail->_next = nullptr;
-                _tail->_prev = nullptr;
-            }
-            else {
-                _tail = _tail->_prev;
-                _tail->_next = nullptr;
-            }
-            tmp->leave();
-            return tmp;
-        }
+
+        node* tmp = _tail;
+        __inner_unlink(tmp);
+        return tmp;
     }
 
-    bool find(node* nd)
+    // O(n), for ASSERTs
+    bool find(const node* nd) const
     {
-        if (nd != nullptr)
-        {
-            // special case
-            if (nd->alone()) {
-                return unique() && nd == _head;
-            }
+        if (nd == nullptr || nd->alone()) {
+            return false;
+        }
 
-            node* tmp = _head;
-            while (tmp != nullptr) {
-                if (nd == tmp) {
-                    return true;
-                }
-                tmp = tmp->_next;
+        for (auto tmp = _head; tmp != nullptr; tmp = tmp->_next) {
+            if (nd == tmp) {
+                return true;
             }
         }
         return false;
@@ -227,59 +250,84 @@ public:
 
     void remove(node* nd) 
     {
-        if (nd != nullptr &&
-            empty() == false &&
-            find(nd) == true)
-        {
-            if (nd == _head) {
-                pop_front();
-            }
-            else if (nd == _tail) {
-                pop_back();
-            }
-            else {
-                nd->_prev->_next = nd->_next;
-                nd->_next->_prev = nd->_prev;
-                nd->leave();
-            }
+        if (nd == nullptr || nd->alone()) {
+            return;
         }
+
+        ASSERT(find(nd));
+        __inner_unlink(nd);
     }
 
     // insert a new node before an exist node
     void insert(node* pos, node* nd) 
     {
-        if (pos != nullptr &&
-            nd  != nullptr &&
-            nd  != pos     &&
-            find(pos) == true) 
-        {
-            if (pos == _head) {
-                push_front(nd);
-            }
-            else if (pos == _tail) {
-                push_back(nd);
-            }
-            else {
-                nd->_prev = pos->_prev;
-                nd->_prev->_next = nd;
-                nd->_next = pos;
-                pos->_prev = nd;
-            }
+        if (pos == nullptr ||
+            nd  == nullptr ||
+            nd  == pos     ||
+            pos->alone()   ||
+            nd->alone() == false) {
+            return;
+        }
+
+        ASSERT(find(pos));
+        // 'nd' goes before 'pos', so tail stays where it is.
+        if (pos == _head) {
+            push_front(nd);
+        }
+        else {
+            nd->_prev   = pos->_prev;
+            nd->_next   = pos;
+            nd->_queued = true;
+            pos->_prev->_next = nd;
+            pos->_prev  = nd;
+            ++_size;
+        }
+    }
+
+    // move all nodes of 'other' to the back, 'other' becomes empty
+    void splice_back(queue_t& other)
+    {
+        if (other.empty() || &other == this) {
+            return;
+        }
+
+        if (empty()) {
+            _head = other._head;
+        }
+        else {
+            _tail->_next = other._head;
+            other._head->_prev = _tail;
         }
+        _tail  = other._tail;
+        _size += other._size;
+
+        other._head = nullptr;
+        other._tail = nullptr;
+        other._size = 0;
     }
 
     uint32_t length() const 
     {
-        uint32_t len = 0;
-        auto itr = head();
-        while (itr != nullptr)
-        {
-            ++len;
-            itr = itr->next();
-        };
-        return len;
+        return size();
     }
 
+private:
+    void __inner_unlink(node* nd)
+    {
+        if (nd->_prev != nullptr) {
+            nd->_prev->_next = nd->_next;
+        } else {
+            _head = nd->_next;
+        }
+
+        if (nd->_next != nullptr) {
+            nd->_next->_prev = nd->_prev;
+        } else {
+            _tail = nd->_prev;
+        }
+        nd->leave();
+        --_size;
+    }
 };
 
-ns_lite_kernel_lib_end
\ No newline at end of file
+ns_lite_kernel_lib_end
@@ -0,0 +1,430 @@
+#pragma once
+#include <lkl.h>
+#include <debug.h>
+
+ns_lite_kernel_lib_begin
+
+template<typename T, typename Key> class rbtree_t;
+
+// node of 'rbtree_t', embedded in the object like 'qnode_t'.
+// key is kept in the node, it's set by 'rbtree_t::insert'.
+template<typename T, typename Key>
+class rbnode_t {
+
+    friend class rbtree_t<T, Key>;
+protected:
+    rbnode_t* _parent = nullptr;
+    rbnode_t* _left   = nullptr;
+    rbnode_t* _right  = nullptr;
+    T*        _pobj;
+    Key       _key;
+    bool      _red    = false;
+    bool      _linked = false;
+public:
+    rbnode_t() { }
+    rbnode_t(T* pobj) : _pobj(pobj) { }
+
+    bool alone() const {
+        return _linked == false;
+    }
+
+    const Key& key() const {
+        return _key;
+    }
+
+    T* get() const noexcept {
+        return _pobj;
+    }
+
+    void reset(T* pobj) {
+        _pobj = pobj;
+    }
+
+    T* operator->() const noexcept {
+        ASSERT(_pobj != nullptr);
+        return _pobj;
+    }
+};
+
+/*
+ * intrusive red-black tree ordered by 'Key' ('<' only).
+ *
+ * nodes live in objects, the tree never allocates, so it can be used
+ * in interrupt context as long as the caller keeps others out. equal
+ * keys are allowed, a new node goes after the ones already there.
+ *
+ * insert/erase/find are O(log n), 'first/next' walk in key order.
+ * all members zero means an empty tree.
+ */
+template<typename T, typename Key>
+class rbtree_t {
+public:
+    typedef rbnode_t<T, Key> node;
+
+private:
+    node*    _root = nullptr;
+    uint32_t _size = 0;
+
+public:
+    bool empty() const {
+        return _root == nullptr;
+    }
+
+    uint32_t size() const {
+        return _size;
+    }
+
+    node* root() {
+        return _root;
+    }
+
+    // smallest key
+    node* first() const {
+        return _root != nullptr ? __inner_min(_root) : nullptr;
+    }
+
+    // largest key
+    node* last() const {
+        return _root != nullptr ? __inner_max(_root) : nullptr;
+    }
+
+    // in-order successor, nullptr at the end
+    static node* next(node* nd) {
+        if (nd->_right != nullptr) {
+            return __inner_min(nd->_right);
+        }
+        node* p = nd->_parent;
+        while (p != nullptr && nd == p->_right) {
+            nd = p;
+            p  = p->_parent;
+        }
+        return p;
+    }
+
+    // in-order predecessor, nullptr at the beginning
+    static node* prev(node* nd) {
+        if (nd->_left != nullptr) {
+            return __inner_max(nd->_left);
+        }
+        node* p = nd->_parent;
+        while (p != nullptr && nd == p->_left) {
+            nd = p;
+            p  = p->_parent;
+        }
+        return p;
+    }
+
+    // first node with 'key', nullptr if there's none
+    node* find(const Key& key) const {
+        node* nd = lower_bound(key);
+        return nd != nullptr && (key < nd->_key) == false ? nd : nullptr;
+    }
+
+    // first node whose key is not less than 'key'
+    node* lower_bound(const Key& key) const {
+        node* res = nullptr;
+        node* itr = _root;
+        while (itr != nullptr) {
+            if (itr->_key < key) {
+                itr = itr->_right;
+            } else {
+                res = itr;
+                itr = itr->_left;
+            }
+        }
+        return res;
+    }
+
+    // last node whose key is not greater than 'key', for lookups like
+    // "which range contains this address"
+    node* floor(const Key& key) const {
+        node* res = nullptr;
+        node* itr = _root;
+        while (itr != nullptr) {
+            if (key < itr->_key) {
+                itr = itr->_left;
+            } else {
+                res = itr;
+                itr = itr->_right;
+            }
+        }
+        return res;
+    }
+
+    void insert(node* nd, const Key& key) {
+        if (nd == nullptr || nd->alone() == false) {
+            return;
+        }
+
+        node*  parent = nullptr;
+        node** link   = &_root;
+        while (*link != nullptr) {
+            parent = *link;
+            link   = key < parent->_key ? &parent->_left : &parent->_right;
+        }
+
+        nd->_key    = key;
+        nd->_parent = parent;
+        nd->_left   = nullptr;
+        nd->_right  = nullptr;
+        nd->_red    = true;
+        nd->_linked = true;
+        *link = nd;
+        ++_size;
+
+        __inner_insert_fixup(nd);
+    }
+
+    void erase(node* nd) {
+        if (nd == nullptr || nd->alone()) {
+            return;
+        }
+
+        // 'x' takes the place of the node actually unlinked, it may be
+        // null, so its parent is tracked separately.
+        node* x;
+        node* xp;
+        bool  red = nd->_red;
+
+        if (nd->_left == nullptr) {
+            x  = nd->_right;
+            xp = nd->_parent;
+            __inner_replace(nd, x);
+        } else if (nd->_right == nullptr) {
+            x  = nd->_left;
+            xp = nd->_parent;
+            __inner_replace(nd, x);
+        } else {
+            // successor has no left child, it moves into 'nd's place
+            node* y = __inner_min(nd->_right);
+            red = y->_red;
+            x   = y->_right;
+            if (y->_parent == nd) {
+                xp = y;
+            } else {
+                xp = y->_parent;
+                __inner_replace(y, x);
+                y->_right = nd->_right;
+                y->_right->_parent = y;
+            }
+            __inner_replace(nd, y);
+            y->_left = nd->_left;
+            y->_left->_parent = y;
+            y->_red = nd->_red;
+        }
+
+        nd->_parent = nullptr;
+        nd->_left   = nullptr;
+        nd->_right  = nullptr;
+        nd->_linked = false;
+        --_size;
+
+        if (red == false) {
+            __inner_erase_fixup(x, xp);
+        }
+    }
+
+private:
+    static node* __inner_min(node* nd) {
+        while (nd->_left != nullptr) {
+            nd = nd->_left;
+        }
+        return nd;
+    }
+
+    static node* __inner_max(node* nd) {
+        while (nd->_right != nullptr) {
+            nd = nd->_right;
+        }
+        return nd;
+    }
+
+    static bool __inner_is_red(const node* nd) {
+        return nd != nullptr && nd->_red;
+    }
+
+    // hang 'nw' where 'old' was under old's parent
+    void __inner_replace(node* old, node* nw) {
+        node* p = old->_parent;
+        if (p == nullptr) {
+            _root = nw;
+        } else if (old == p->_left) {
+            p->_left = nw;
+        } else {
+            p->_right = nw;
+        }
+        if (nw != nullptr) {
+            nw->_parent = p;
+        }
+    }
+
+    void __inner_rotate_left(node* x) {
+        node* y = x->_right;
+        x->_right = y->_left;
+        if (y->_left != nullptr) {
+            y->_left->_parent = x;
+        }
+        __inner_replace(x, y);
+        y->_left   = x;
+        x->_parent = y;
+    }
+
+    void __inner_rotate_right(node* x) {
+        node* y = x->_left;
+        x->_left = y->_right;
+        if (y->_right != nullptr) {
+            y->_right->_parent = x;
+        }
+        __inner_replace(x, y);
+        y->_right  = x;
+        x->_parent = y;
+    }
+
+    void __inner_insert_fixup(node* nd) {
+        while (__inner_is_red(nd->_parent)) {
+            // red parent is never root, grandparent exists
+            node* p = nd->_parent;
+            node* g = p->_parent;
+            if (p == g->_left) {
+                node* u = g->_right;
+                if (__inner_is_red(u)) {
+                    p->_red = false;
+                    u->_red = false;
+                    g->_red = true;
+                    nd      = g;
+                    continue;
+                }
+                if (nd == p->_right) {
+                    __inner_rotate_left(p);
+                    nd = p;
+                    p  = nd->_parent;
+                }
+                p->_red = false;
+                g->_red = true;
+                __inner_rotate_right(g);
+            } else {
+                node* u = g->_left;
+                if (__inner_is_red(u)) {
+                    p->_red = false;
+                    u->_red = false;
+                    g->_red = true;
+                    nd      = g;
+                    continue;
+                }
+                if (nd == p->_left) {
+                    __inner_rotate_right(p);
+                    nd = p;
+                    p  = nd->_parent;
+                }
+                p->_red = false;
+                g->_red = true;
+                __inner_rotate_left(g);
+            }
+        }
+        _root->_red = false;
+    }
+
+    void __inner_erase_fixup(node* x, node* xp) {
+        while (x != _root && __inner_is_red(x) == false) {
+            if (x == xp->_left) {
+                node* w = xp->_right;
+                if (w->_red) {
+                    w->_red  = false;
+                    xp->_red = true;
+                    __inner_rotate_left(xp);
+                    w = xp->_right;
+                }
+                if (__inner_is_red(w->_left) == false &&
+                    __inner_is_red(w->_right) == false) {
+                    w->_red = true;
+                    x  = xp;
+                    xp = x->_parent;
+                    continue;
+                }
+                if (__inner_is_red(w->_right) == false) {
+                    w->_left->_red = false;
+                    w->_red = true;
+                    __inner_rotate_right(w);
+                    w = xp->_right;
+                }
+                w->_red  = xp->_red;
+                xp->_red = false;
+                w->_right->_red = false;
+                __inner_rotate_left(xp);
+                x = _root;
+            } else {
+                node* w = xp->_left;
+                if (w->_red) {
+                    w->_red  = false;
+                    xp->_red = true;
+                    __inner_rotate_right(xp);
+                    w = xp->_left;
+                }
+                if (__inner_is_red(w->_left) == false &&
+                    __inner_is_red(w->_right) == false) {
+                    w->_red = true;
+                    x  = xp;
+                    xp = x->_parent;
+                    continue;
+                }
+                if (__inner_is_red(w->_left) == false) {
+                    w->_right->_red = false;
+                    w->_red = true;
+                    __inner_rotate_left(w);
+                    w = xp->_left;
+                }
+                w->_red  = xp->_red;
+                xp->_red = false;
+                w->_left->_red = false;
+                __inner_rotate_right(xp);
+                x = _root;
+            }
+        }
+        if (x != nullptr) {
+            x->_red = false;
+        }
+    }
+
+public:
+    // walk the whole tree, check links, order, colors and size.
+    // O(n), meant for ASSERTs and tests.
+    bool valid() const {
+        if (_root == nullptr) {
+            return _size == 0;
+        }
+        if (_root->_red || _root->_parent != nullptr) {
+            return false;
+        }
+        uint32_t cnt = 0;
+        return __inner_black_height(_root, cnt) > 0 && cnt == _size;
+    }
+
+private:
+    // black height of subtree 'nd', 0 if a rule is broken in it.
+    // recursion is as deep as the tree, O(log n).
+    static uint32_t __inner_black_height(const node* nd, uint32_t& cnt) {
+        if (nd == nullptr) {
+            return 1;
+        }
+        ++cnt;
+
+        const node* l = nd->_left;
+        const node* r = nd->_right;
+        if (nd->_linked == false ||
+            (l != nullptr && (l->_parent != nd || nd->_key < l->_key)) ||
+            (r != nullptr && (r->_parent != nd || r->_key < nd->_key)) ||
+            (nd->_red && (__inner_is_red(l) || __inner_is_red(r))))
+        {
+            return 0;
+        }
+
+        uint32_t lh = __inner_black_height(l, cnt);
+        uint32_t rh = __inner_black_height(r, cnt);
+        if (lh == 0 || lh != rh) {
+            return 0;
+        }
+        return nd->_red ? lh : lh + 1;
+    }
+};
+
+ns_lite_kernel_lib_end
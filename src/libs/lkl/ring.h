@@ -0,0 +1,185 @@
+#pragma once
+#include <lkl.h>
+
+ns_lite_kernel_lib_begin
+
+/*
+ * fixed size rings, no lock, no allocation.
+ *
+ * 'N' must be a power of 2. indices run freely and wrap around at
+ * 2^32, slot of index 'i' is 'i & (N-1)'. 'head - tail' is always the
+ * number of items, even after wrapping, since 'N' divides 2^32.
+ */
+
+// single producer, single consumer.
+// producer only writes '_head', consumer only writes '_tail'. each side
+// publishes its index with release and reads the other's with acquire,
+// that's all the ordering a slot needs.
+template<typename T, uint32_t N>
+class spsc_ring
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0,
+                  "ring size must be a power of 2.");
+    enum : uint32_t
+    {
+        MASK = N - 1
+    };
+private:
+    T        _buf[N];
+    uint32_t _head = 0;
+    uint32_t _tail = 0;
+public:
+    static constexpr uint32_t
+    capacity() {
+        return N;
+    }
+
+    // producer side
+    bool
+    push(const T& val) {
+        uint32_t head = _head;
+        if(head - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE) == N) {
+            return false;
+        }
+        _buf[head & MASK] = val;
+        __atomic_store_n(&_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // consumer side
+    bool
+    pop(T& val) {
+        uint32_t tail = _tail;
+        if(__atomic_load_n(&_head, __ATOMIC_ACQUIRE) == tail) {
+            return false;
+        }
+        val = _buf[tail & MASK];
+        __atomic_store_n(&_tail, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // either side, it's a snapshot
+    uint32_t
+    size() const {
+        return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) -
+               __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    }
+
+    bool
+    empty() const {
+        return size() == 0;
+    }
+
+    bool
+    full() const {
+        return size() == N;
+    }
+};
+
+// multiple producers, multiple consumers (Dmitry Vyukov's bounded
+// queue). each slot carries a sequence number telling whose turn it is:
+//   seq == pos      free, producer claiming 'pos' may write it
+//   seq == pos + 1  full, consumer claiming 'pos' may read it
+// a position is claimed by CAS on '_enq'/'_deq', the slot is handed
+// over by storing next sequence with release.
+template<typename T, uint32_t N>
+class mpmc_ring
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0,
+                  "ring size must be a power of 2.");
+    enum : uint32_t
+    {
+        MASK = N - 1
+    };
+
+    struct cell_t
+    {
+        uint32_t seq;
+        T        val;
+    };
+private:
+    cell_t   _cells[N];
+    uint32_t _enq = 0;
+    uint32_t _deq = 0;
+public:
+    mpmc_ring() {
+        for(uint32_t i = 0; i < N; ++i) {
+            _cells[i].seq = i;
+        }
+    }
+
+    static constexpr uint32_t
+    capacity() {
+        return N;
+    }
+
+    bool
+    push(const T& val) {
+        uint32_t pos = __atomic_load_n(&_enq, __ATOMIC_RELAXED);
+        cell_t*  cell;
+        while(true) {
+            cell = &_cells[pos & MASK];
+            uint32_t seq  = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+            int32_t  diff = (int32_t)(seq - pos);
+            if(diff == 0) {
+                // slot is free, claim it. 'pos' is reloaded if failed.
+                if(__atomic_compare_exchange_n(
+                    &_enq, &pos, pos + 1, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                {
+                    break;
+                }
+            } else if(diff < 0) {
+                // slot still holds an item from last lap
+                return false;
+            } else {
+                pos = __atomic_load_n(&_enq, __ATOMIC_RELAXED);
+            }
+        }
+        cell->val = val;
+        __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool
+    pop(T& val) {
+        uint32_t pos = __atomic_load_n(&_deq, __ATOMIC_RELAXED);
+        cell_t*  cell;
+        while(true) {
+            cell = &_cells[pos & MASK];
+            uint32_t seq  = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+            int32_t  diff = (int32_t)(seq - (pos + 1));
+            if(diff == 0) {
+                if(__atomic_compare_exchange_n(
+                    &_deq, &pos, pos + 1, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                {
+                    break;
+                }
+            } else if(diff < 0) {
+                // nothing written there yet
+                return false;
+            } else {
+                pos = __atomic_load_n(&_deq, __ATOMIC_RELAXED);
+            }
+        }
+        val = cell->val;
+        // free for producer of next lap
+        __atomic_store_n(&cell->seq, pos + N, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // snapshot, might be off while others are in the middle
+    uint32_t
+    size() const {
+        return __atomic_load_n(&_enq, __ATOMIC_ACQUIRE) -
+               __atomic_load_n(&_deq, __ATOMIC_ACQUIRE);
+    }
+
+    bool
+    empty() const {
+        return size() == 0;
+    }
+};
+
+ns_lite_kernel_lib_end
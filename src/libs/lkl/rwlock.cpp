@@ -0,0 +1,67 @@
+#include <rwlock.h>
+#include <intmgr.h>
+
+ns_lite_kernel_lib_begin
+
+void
+rwlock_t::read_lock()
+{
+    intr_guard guard(false);
+    // writer preference: queued writers go first
+    while(_writer || _writers_waiting > 0) {
+        _rd_queue.sleep();
+    }
+    ++_readers;
+}
+
+void
+rwlock_t::read_unlock()
+{
+    intr_guard guard(false);
+    ASSERT(_readers > 0 && _writer == false);
+    if(--_readers == 0 && _writers_waiting > 0) {
+        __inner_handoff();
+    }
+}
+
+void
+rwlock_t::write_lock()
+{
+    intr_guard guard(false);
+    if(_writer == false && _readers == 0) {
+        _writer = true;
+        return;
+    }
+
+    ++_writers_waiting;
+    do {
+        _wt_queue.sleep();
+    } while(_handoff == false);
+    _handoff = false;
+    --_writers_waiting;
+    ASSERT(_writer);
+}
+
+void
+rwlock_t::write_unlock()
+{
+    intr_guard guard(false);
+    ASSERT(_writer);
+    if(_writers_waiting > 0) {
+        __inner_handoff();
+        return;
+    }
+    _writer = false;
+    _rd_queue.notify_all();
+}
+
+void
+rwlock_t::__inner_handoff()
+{
+    ASSERT(_handoff == false && _wt_queue.empty() == false);
+    _writer  = true;
+    _handoff = true;
+    _wt_queue.notify_one();
+}
+
+ns_lite_kernel_lib_end
@@ -0,0 +1,85 @@
+#pragma once
+#include <lkl.h>
+#include <waitq.h>
+
+ns_lite_kernel_lib_begin
+
+/*
+ * reader-writer lock with writer preference.
+ *
+ * any number of readers or one writer. once a writer is waiting, new
+ * readers queue up behind it, so a steady stream of readers can't
+ * starve writers. a leaving writer wakes the next writer if there is
+ * one, otherwise all readers.
+ *
+ * a writer is woken only to be handed the lock: '_writer' is set for
+ * it before it runs, so nobody can take the lock in between.
+ *
+ * like semaphore_t, state is protected by turning interrupt off and
+ * waiters re-check after waking up. not recursive, threads only.
+ */
+class rwlock_t
+{
+private:
+    uint32_t          _readers = 0;     // active readers
+    bool              _writer  = false; // a writer is in
+    // writers sleeping in 'write_lock', woken ones included until
+    // they run. '_wt_queue' alone can't tell, a woken writer has left it.
+    uint32_t          _writers_waiting = 0;
+    bool              _handoff = false; // lock handed to a woken writer
+    wait_queue_t      _rd_queue;
+    wait_queue_t      _wt_queue;
+public:
+    void
+    read_lock();
+
+    void
+    read_unlock();
+
+    void
+    write_lock();
+
+    void
+    write_unlock();
+
+private:
+    // give the lock to first sleeping writer, interrupt must be off
+    void
+    __inner_handoff();
+};
+
+class read_lock_guard
+{
+    rwlock_t& _lock;
+public:
+    read_lock_guard(rwlock_t& lock) : _lock(lock) {
+        _lock.read_lock();
+    }
+
+    ~read_lock_guard() {
+        _lock.read_unlock();
+    }
+
+    // non-assignable
+    read_lock_guard(read_lock_guard const&) = delete;
+    read_lock_guard& operator=(read_lock_guard const&) = delete;
+};
+
+class write_lock_guard
+{
+    rwlock_t& _lock;
+public:
+    write_lock_guard(rwlock_t& lock) : _lock(lock) {
+        _lock.write_lock();
+    }
+
+    ~write_lock_guard() {
+        _lock.write_unlock();
+    }
+
+    // non-assignable
+    write_lock_guard(write_lock_guard const&) = delete;
+    write_lock_guard& operator=(write_lock_guard const&) = delete;
+};
+
+ns_lite_kernel_lib_end
@@ -2,6 +2,7 @@
 #include <thread.h>
 #include <tskmgr.h>
 #include <intmgr.h>
+#include <timer.h>
 
 ns_lite_kernel_lib_begin
 
@@ -19,6 +20,28 @@ semaphore_t::down()
     --_value;
 }
 
+bool
+semaphore_t::down_timeout(uint32_t ms)
+{
+    intr_guard guard(false);
+    uint32_t dl = timer_mgr::deadline(ms);
+    while(_value == 0) {
+
+        if(ms == 0 || timer_mgr::expired(dl)) {
+            return false;
+        }
+
+        auto th = task_mgr::current_thread();
+        ASSERT(th->is_running() && th->node().alone());
+        _wait_queue.push_back(th->node_ptr());
+        if(task_mgr::block_until(dl, &_wait_queue) == false) {
+            return false;
+        }
+    }
+    --_value;
+    return true;
+}
+
 void
 semaphore_t::up()
 {
@@ -30,6 +30,11 @@ public:
     void
     down();
 
+    // same as down() but gives up after 'ms' milliseconds
+    // return false if timed out, 'ms' = 0 never blocks.
+    bool
+    down_timeout(uint32_t ms);
+
     // 'V':up()
     // increase semaphore._value
     // wake up another thread in wait queue
@@ -0,0 +1,85 @@
+#pragma once
+#include <lkl.h>
+#include <x86/asm.h>
+
+ns_lite_kernel_lib_begin
+
+/*
+ * sequence lock for small read-mostly data.
+ *
+ * writer makes '_seq' odd while it's updating and even again when it's
+ * done. reader never writes anything, it copies the data and tries
+ * again if '_seq' was odd or changed meanwhile:
+ *
+ *     uint32_t seq;
+ *     do {
+ *         seq = sl.read_begin();
+ *         copy = data;
+ *     } while(sl.read_retry(seq));
+ *
+ * writers must be serialized and can't be interrupted by a reader on
+ * the same cpu, or the reader would spin forever. 'seq_write_guard'
+ * turns interrupt off for that.
+ */
+class seqlock_t
+{
+private:
+    uint32_t _seq = 0;
+public:
+    inline uint32_t
+    read_begin() const {
+        uint32_t seq;
+        while((seq = __atomic_load_n(&_seq, __ATOMIC_ACQUIRE)) & 1) {
+            x86_asm::cpu_relax();
+        }
+        return seq;
+    }
+
+    inline bool
+    read_retry(uint32_t seq) const {
+        // reads of data complete before '_seq' is checked
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&_seq, __ATOMIC_RELAXED) != seq;
+    }
+
+    // interrupt must be off
+    inline void
+    write_begin() {
+        __atomic_store_n(&_seq, _seq + 1, __ATOMIC_RELAXED);
+        // '_seq' is odd before any data changes
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    inline void
+    write_end() {
+        __atomic_store_n(&_seq, _seq + 1, __ATOMIC_RELEASE);
+    }
+};
+
+// turns interrupt off by itself rather than with 'intr_guard',
+// intmgr.h includes clock.h which uses seqlock_t.
+class seq_write_guard
+{
+    seqlock_t& _lock;
+    bool       _old_intr;
+public:
+    seq_write_guard(seqlock_t& lock)
+        : _lock(lock),
+          _old_intr(x86_asm::is_interrupt_on()) {
+        x86_asm::turn_interrupt_off();
+        _lock.write_begin();
+    }
+
+    ~seq_write_guard() {
+        _lock.write_end();
+        if(_old_intr) {
+            x86_asm::turn_interrupt_on();
+        }
+    }
+
+    // non-assignable
+    seq_write_guard(seq_write_guard const&) = delete;
+    seq_write_guard& operator=(seq_write_guard const&) = delete;
+};
+
+ns_lite_kernel_lib_end
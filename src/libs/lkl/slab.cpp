@@ -0,0 +1,260 @@
+#include <slab.h>
+#include <memory.h>
+#include <semaphore.h>
+#include <bit.h>
+#include <debug.h>
+
+ns_lite_kernel_lib_begin
+
+// -----------------------------------------------------------------------
+// Object Cache
+
+kmem_cache_t::kmem_cache_t(
+    const char* name,
+    uint32_t    size,
+    kmem_ctor   ctor)
+    : _name(name),
+      _ctor(ctor)
+{
+    // a free object holds the freelist link, keep them word aligned
+    _size  = size < sizeof(void*) ? sizeof(void*) : size;
+    _size  = (_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    _total = (PAGE_SIZE - SLAB_HDR_SIZE) / _size;
+    ASSERT(_total > 0 && "object is too large for a slab.");
+}
+
+void*
+kmem_cache_t::alloc()
+{
+    lock_guard al(_lock);
+
+    slab_t* slab = nullptr;
+    if(_partial.empty() == false) {
+        slab = _partial.head()->get();
+    } else if(_empty.empty() == false) {
+        slab = _empty.pop_front()->get();
+        --_nempty;
+        _partial.push_front(&slab->_node);
+    } else {
+        slab = __inner_grow();
+        if(slab == nullptr) {
+            return nullptr;
+        }
+        _partial.push_front(&slab->_node);
+    }
+
+    void* obj   = slab->_free;
+    slab->_free = *(void**)obj;
+    ++slab->_inuse;
+    ++_nobjs;
+
+    // slab is full, it's always the head of '_partial'
+    if(slab->_inuse == _total) {
+        _partial.pop_front();
+    }
+
+    if(_ctor != nullptr) {
+        _ctor(obj);
+    }
+    return obj;
+}
+
+void
+kmem_cache_t::free(void* obj)
+{
+    if(obj == nullptr) {
+        return;
+    }
+
+    auto slab = __inner_slab_of(obj);
+    ASSERT(slab->_cache == this && "object doesn't belong to cache.");
+    ASSERT(slab->_inuse > 0 && "double free.");
+
+    lock_guard al(_lock);
+
+    bool full   = slab->_inuse == _total;
+    *(void**)obj = slab->_free;
+    slab->_free  = obj;
+    --slab->_inuse;
+    --_nobjs;
+
+    if(slab->_inuse == 0) {
+        if(full == false) {
+            _partial.remove(&slab->_node);
+        }
+
+        // a few empty slabs are kept for later allocations
+        if(_nempty < MAX_EMPTY) {
+            _empty.push_front(&slab->_node);
+            ++_nempty;
+        } else {
+            __inner_release(slab);
+        }
+    } else if(full) {
+        _partial.push_front(&slab->_node);
+    }
+}
+
+kmem_cache_t::slab_t*
+kmem_cache_t::__inner_grow()
+{
+    auto slab = (slab_t*)mem_mgr::alloc(mem_mgr::PT_KERNEL, 1);
+    if(slab == nullptr) {
+        return nullptr;
+    }
+
+    slab->_node.leave();
+    slab->_node.reset(slab);
+    slab->_cache = this;
+    slab->_inuse = 0;
+    slab->_pages = 1;
+    slab->_magic = SLAB_MAGIC;
+
+    // link objects in address order
+    auto  base = (uint8_t*)slab + SLAB_HDR_SIZE;
+    void* next = nullptr;
+    for(uint32_t i = _total; i > 0; --i) {
+        void* obj    = base + (i - 1) * _size;
+        *(void**)obj = next;
+        next         = obj;
+    }
+    slab->_free = next;
+
+    ++_nslabs;
+    return slab;
+}
+
+void
+kmem_cache_t::__inner_release(slab_t* slab)
+{
+    slab->_magic = 0;
+    --_nslabs;
+    mem_mgr::free(mem_mgr::PT_KERNEL, slab, 1);
+}
+
+// -----------------------------------------------------------------------
+// Slab Manager
+
+// the slab header takes the front of each page, a 2KB class would hold
+// one object per slab and waste half of it. larger requests take whole
+// pages instead, 'kmalloc-1024' holds three.
+kmem_cache_t slab_mgr::s_caches[NUM_CACHES] = {
+    kmem_cache_t("kmalloc-16",   16),
+    kmem_cache_t("kmalloc-32",   32),
+    kmem_cache_t("kmalloc-64",   64),
+    kmem_cache_t("kmalloc-128",  128),
+    kmem_cache_t("kmalloc-256",  256),
+    kmem_cache_t("kmalloc-512",  512),
+    kmem_cache_t("kmalloc-1024", 1024),
+};
+
+kmem_cache_t*
+slab_mgr::size_cache(size_t size)
+{
+    if(size > MAX_SIZE) {
+        return nullptr;
+    }
+
+    uint32_t shift = size <= (1u << MIN_SHIFT) ?
+                     MIN_SHIFT :
+                     bit_msb(size - 1) + 1;
+    return &s_caches[shift - MIN_SHIFT];
+}
+
+void*
+slab_mgr::kmalloc(size_t size)
+{
+    if(size == 0) {
+        return nullptr;
+    }
+
+    auto cache = size_cache(size);
+    if(cache != nullptr) {
+        return cache->alloc();
+    }
+
+    // large allocation: whole pages with a slab header in front
+    using slab_t = kmem_cache_t::slab_t;
+    uint32_t cnt = (size + kmem_cache_t::SLAB_HDR_SIZE + PAGE_SIZE - 1) /
+                   PAGE_SIZE;
+
+    auto slab = (slab_t*)mem_mgr::alloc(mem_mgr::PT_KERNEL, cnt);
+    if(slab == nullptr) {
+        return nullptr;
+    }
+
+    slab->_node.leave();
+    slab->_node.reset(slab);
+    slab->_cache = nullptr;
+    slab->_free  = nullptr;
+    slab->_inuse = 1;
+    slab->_pages = (uint16_t)cnt;
+    slab->_magic = kmem_cache_t::SLAB_MAGIC;
+    return (uint8_t*)slab + kmem_cache_t::SLAB_HDR_SIZE;
+}
+
+void
+slab_mgr::kfree(void* ptr)
+{
+    if(ptr == nullptr) {
+        return;
+    }
+
+    auto slab = kmem_cache_t::__inner_slab_of(ptr);
+    if(slab->_cache != nullptr) {
+        slab->_cache->free(ptr);
+        return;
+    }
+
+    // large allocation
+    ASSERT(slab->_inuse == 1 && "double free.");
+    slab->_inuse = 0;
+    slab->_magic = 0;
+    mem_mgr::free(mem_mgr::PT_KERNEL, slab, slab->_pages);
+}
+
+obj_cache_t<semaphore_t>&
+slab_mgr::sema_cache()
+{
+    static obj_cache_t<semaphore_t> s_cache("semaphore_t");
+    return s_cache;
+}
+
+obj_cache_t<qnode_t<thread_t>>&
+slab_mgr::qnode_cache()
+{
+    static obj_cache_t<qnode_t<thread_t>> s_cache("qnode_t");
+    return s_cache;
+}
+
+//
+// -----------------------------------------------------------------------
+
+ns_lite_kernel_lib_end
+
+// -----------------------------------------------------------------------
+// global new/delete, backed by kmalloc
+
+void* operator new(size_t size) {
+    return lkl::kmalloc(size);
+}
+
+void* operator new[](size_t size) {
+    return lkl::kmalloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    lkl::kfree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    lkl::kfree(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    lkl::kfree(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    lkl::kfree(ptr);
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include <lkl.h>
+#include <stddef.h>
+#include <x86/pg.h>
+#include <queue.h>
+#include <lock.h>
+
+// placement new, there's no <new> in a freestanding build
+inline void* operator new(size_t, void* ptr) noexcept { return ptr; }
+inline void* operator new[](size_t, void* ptr) noexcept { return ptr; }
+
+ns_lite_kernel_lib_begin
+
+// called on every object handed out by a cache
+typedef void (*kmem_ctor)(void* obj);
+
+/*
+ * Slab Allocator
+ * a cache hands out objects of one fixed size. memory comes from
+ * 'mem_mgr::alloc(PT_KERNEL, 1)' one page (a slab) at a time, the slab
+ * header sits at the page base and objects fill the rest of the page.
+ * free objects are linked through their first word, so alloc/free are
+ * just a pop/push on the slab's freelist.
+ *
+ *   page base                                             page end
+ *   ┌────────┬───────┬───────┬───────┬─────┬───────┬──────┐
+ *   │ slab_t │ obj 0 │ obj 1 │ obj 2 │ ... │ obj n │ waste│
+ *   └────────┴───────┴───────┴───────┴─────┴───────┴──────┘
+ *
+ * because a slab never crosses a page, the slab (and its cache) of any
+ * object is found by masking the low 12 bits of its address.
+ *
+ * slabs which have free objects are kept on '_partial', the ones
+ * without any object in use on '_empty' (at most MAX_EMPTY of them,
+ * others go back to mem_mgr). full slabs are on no list at all, a
+ * free() puts them back to '_partial'.
+ */
+class kmem_cache_t
+{
+    friend class slab_mgr;
+private:
+    struct slab_t
+    {
+        qnode_t<slab_t>  _node;
+        kmem_cache_t*    _cache;  // nullptr: a large allocation
+        void*            _free;   // first free object
+        uint16_t         _inuse;  // objects in use
+        uint16_t         _pages;  // large allocation only
+        uint32_t         _magic;
+    };
+
+    enum
+    {
+        SLAB_MAGIC    = 0x51AB'C0DE,
+        SLAB_HDR_SIZE = (sizeof(slab_t) + 0xF) & ~0xF,
+        MAX_EMPTY     = 2  // empty slabs kept, the rest are released
+    };
+
+    const char*         _name;
+    uint32_t            _size;    // object size
+    uint32_t            _total;   // objects per slab
+    kmem_ctor           _ctor;
+    queue_t<slab_t>     _partial;
+    queue_t<slab_t>     _empty;
+    uint32_t            _nslabs = 0;
+    uint32_t            _nempty = 0;
+    uint32_t            _nobjs  = 0; // objects in use
+    lock_t              _lock;
+
+public:
+    kmem_cache_t(
+        const char* name,
+        uint32_t    size,
+        kmem_ctor   ctor = nullptr);
+
+    // non-copyable
+    kmem_cache_t(const kmem_cache_t&)            = delete;
+    kmem_cache_t& operator=(const kmem_cache_t&) = delete;
+
+    // nullptr if out of memory
+    void*
+    alloc();
+
+    void
+    free(void* obj);
+
+    const char* name() const {
+        return _name;
+    }
+
+    uint32_t obj_size() const {
+        return _size;
+    }
+
+    uint32_t objs_per_slab() const {
+        return _total;
+    }
+
+    uint32_t slab_count() const {
+        return _nslabs;
+    }
+
+    uint32_t inuse_count() const {
+        return _nobjs;
+    }
+
+    // cache which 'obj' came from, nullptr for large allocations
+    static kmem_cache_t*
+    cache_of(void* obj) {
+        return __inner_slab_of(obj)->_cache;
+    }
+
+private:
+    static slab_t*
+    __inner_slab_of(void* obj) {
+        auto slab = (slab_t*)((uint32_t)obj & MASK_H20_BITS);
+        ASSERT(slab->_magic == SLAB_MAGIC && "not a slab object.");
+        return slab;
+    }
+
+    slab_t*
+    __inner_grow();
+
+    void
+    __inner_release(slab_t* slab);
+};
+
+// cache of a single type, create()/destroy() run T's ctor/dtor
+template<typename T>
+class obj_cache_t : public kmem_cache_t
+{
+public:
+    obj_cache_t(const char* name, kmem_ctor ctor = nullptr)
+        : kmem_cache_t(name, sizeof(T), ctor) {
+    }
+
+    template<typename... Args>
+    T*
+    create(Args... args) {
+        void* ptr = alloc();
+        return ptr != nullptr ? new(ptr) T(args...) : nullptr;
+    }
+
+    void
+    destroy(T* obj) {
+        if(obj != nullptr) {
+            obj->~T();
+            free(obj);
+        }
+    }
+};
+
+class semaphore_t;
+class thread_t;
+
+class slab_mgr
+{
+public:
+    enum
+    {
+        MIN_SHIFT  = 4,                    // 16 bytes
+        MAX_SHIFT  = 10,                   // 1 KB
+        NUM_CACHES = MAX_SHIFT - MIN_SHIFT + 1,
+        MAX_SIZE   = 1 << MAX_SHIFT
+    };
+
+private:
+    static kmem_cache_t s_caches[NUM_CACHES];
+
+public:
+    // 'kmalloc' picks the smallest size class fits 'size', anything
+    // larger than MAX_SIZE takes whole pages.
+    static void*
+    kmalloc(size_t size);
+
+    static void
+    kfree(void* ptr);
+
+    // size class cache, nullptr if 'size' > MAX_SIZE
+    static kmem_cache_t*
+    size_cache(size_t size);
+
+    // named caches
+    static obj_cache_t<semaphore_t>&
+    sema_cache();
+
+    static obj_cache_t<qnode_t<thread_t>>&
+    qnode_cache();
+
+private:
+    // creating an instance is disallowed.
+    slab_mgr() = delete;
+};
+
+inline void*
+kmalloc(size_t size) {
+    return slab_mgr::kmalloc(size);
+}
+
+inline void
+kfree(void* ptr) {
+    slab_mgr::kfree(ptr);
+}
+
+ns_lite_kernel_lib_end
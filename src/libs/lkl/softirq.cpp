@@ -0,0 +1,58 @@
+#include <softirq.h>
+#include <x86/asm.h>
+#include <debug.h>
+#include <tskmgr.h>
+
+ns_lite_kernel_lib_begin
+
+spsc_ring<softirq_mgr::work_t, softirq_mgr::SIRQ_RING_SIZE>
+         softirq_mgr::s_ring;
+bool     softirq_mgr::s_running = false;
+uint32_t softirq_mgr::s_raised  = 0;
+uint32_t softirq_mgr::s_dropped = 0;
+
+bool
+softirq_mgr::raise(softirq_fn fn, uint32_t arg)
+{
+    ASSERT(fn != nullptr && x86_asm::is_interrupt_on() == false);
+
+    if(s_ring.push(work_t{fn, arg}) == false) {
+        ++s_dropped;
+        return false;
+    }
+    ++s_raised;
+    return true;
+}
+
+void
+softirq_mgr::run()
+{
+    if(s_running || pending() == false) {
+        return;
+    }
+
+    s_running = true;
+    // an item raised after the last check but before 'cli' would stay
+    // until next interrupt, check again with interrupt off.
+    do {
+        x86_asm::turn_interrupt_on();
+        work_t w;
+        while(s_ring.pop(w)) {
+            w.fn(w.arg);
+        }
+        x86_asm::turn_interrupt_off();
+    } while(pending());
+    s_running = false;
+
+    // a tick taken during the drain didn't switch threads, the drain
+    // must not be parked on this stack. switch now if it wanted to.
+    task_mgr::resched_deferred();
+}
+
+ns_lite_kernel_lib_end
+
+// called by int.s on ISR exit
+extern "C" void
+softirq_run() {
+    lkl::softirq_mgr::run();
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <lkl.h>
+#include <ring.h>
+
+ns_lite_kernel_lib_begin
+
+// deferred work, 'arg' is whatever the ISR wants to pass on
+typedef void (*softirq_fn)(uint32_t arg);
+
+/*
+ * softirq_mgr moves work out of interrupt context.
+ *
+ * an ISR does the least it has to (read a port, ack a device) and
+ * 'raise's the rest as a small work item. items are run in order on
+ * the way out of the ISR (int.s calls 'softirq_run' after the handler)
+ * with interrupts on, so a long decode doesn't keep other interrupts
+ * waiting. idle thread drains the ring as well.
+ *
+ * the ring has one producer and one consumer: ISRs don't nest, and
+ * only one drain runs at a time, an interrupt taken during a drain
+ * doesn't start another one. so indices need no lock, only ordering.
+ * there's one cpu, so one ring.
+ *
+ * a drain is never preempted: task_mgr holds back a switch wanted
+ * while it runs and does it after the drain ends. otherwise the drain
+ * would be parked on a switched out thread's stack, and work raised
+ * meanwhile would wait for that thread to run again.
+ *
+ * work items run in interrupt context as far as threads are concerned:
+ * they can wake threads up but must never block.
+ */
+class softirq_mgr
+{
+public:
+    enum
+    {
+        SIRQ_RING_SIZE = 64    // power of 2
+    };
+private:
+    struct work_t
+    {
+        softirq_fn fn;
+        uint32_t   arg;
+    };
+
+    static spsc_ring<work_t, SIRQ_RING_SIZE> s_ring;
+    static bool     s_running;
+    static uint32_t s_raised;
+    static uint32_t s_dropped;
+public:
+    // queue 'fn(arg)', called with interrupt off (from an ISR).
+    // return false if ring is full, the work is dropped.
+    static bool
+    raise(softirq_fn fn, uint32_t arg);
+
+    // run pending work with interrupt on.
+    // called with interrupt off, returns with interrupt off.
+    static void
+    run();
+
+    static inline bool
+    pending() {
+        return s_ring.empty() == false;
+    }
+
+    // a work item is running, code can't block. a drain is never
+    // switched out, so this is about the current context only.
+    static inline bool
+    running() {
+        return s_running;
+    }
+
+    static inline uint32_t
+    raised() {
+        return s_raised;
+    }
+
+    static inline uint32_t
+    dropped() {
+        return s_dropped;
+    }
+
+private:
+    // creating an instance is disallowed
+    softirq_mgr() = delete;
+};
+
+ns_lite_kernel_lib_end
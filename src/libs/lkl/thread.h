@@ -2,14 +2,19 @@
 #include <lkl.h>
 #include <string.h>
 #include <queue.h>
+#include <heap.h>
 #include <debug.h>
 #include <bit.h>
 
 ns_lite_kernel_lib_begin
 
+class lock_t;
+
 class thread_t
 {
     friend class task_mgr;
+    friend class timer_mgr;
+    friend class lock_t;
 public:
     enum state_t : uint32_t
     {
@@ -18,7 +23,8 @@ public:
         TS_READY    = 0x0000'0002,
         TS_WAITING  = 0x0000'0003,
         TS_BLOCKED  = 0x0000'0004,
-        TS_HANGING  = 0x0000'0005
+        TS_HANGING  = 0x0000'0005,
+        TS_EXITED   = 0x0000'0006  // waiting to be reaped
     };
 
     enum
@@ -34,11 +40,32 @@ private:
     uint32_t    _tid;
     state_t     _state;
     uint32_t    _base_prior;
+    // effective priority, '_base_prior' boosted by waiters of locks it
+    // holds. ready queue and preemption go by this one.
+    uint32_t    _eff_prior;
+    // ticks left in time slice
     uint32_t    _prior;
     // name is not necessary, but could make debugging easier.
     char        _name[TH_NAME_LEN];
     tnode       _node;
     tnode       _anode;
+    // threads waiting for this one to exit
+    queue_t<thread_t> _joiners;
+    // set by the thread it joins on exit, its TCB may be gone by the
+    // time we run again.
+    bool        _join_done;
+    // sleep heap node, '_wakeup' is the tick to wake up at.
+    hnode_t<thread_t> _snode;
+    uint32_t    _wakeup;
+    // wait queue '_node' is in during a timed block, timer takes the
+    // thread out of it on timeout.
+    queue_t<thread_t>* _waitq;
+    bool        _timed_out;
+    // cycle it was made ready by 'unblock_thread', 0 if not measured
+    uint64_t    _ready_at;
+    // lock it's waiting for, locks it holds that have waiters
+    lock_t*         _blocked_on;
+    queue_t<lock_t> _held;
 
     // _magic is the tcb keeper, should always be the last member
     // of thread_t.
@@ -73,6 +100,11 @@ public:
         return _state == TS_HANGING;
     }
 
+    inline bool
+    is_exited() const {
+        return _state == TS_EXITED;
+    }
+
     inline state_t
     state() const {
         return _state;
@@ -128,6 +160,16 @@ public:
         return &_anode;;
     }
 
+    inline hnode_t<thread_t>*
+    snode_ptr() {
+        return &_snode;
+    }
+
+    inline uint32_t
+    wakeup() const {
+        return _wakeup;
+    }
+
     inline uint32_t
     prior() const {
         return _prior;
@@ -138,6 +180,11 @@ public:
         return _base_prior;
     }
 
+    inline uint32_t
+    eff_prior() const {
+        return _eff_prior;
+    }
+
     inline uint32_t
     magic() const {
         return _magic;
@@ -185,15 +232,27 @@ protected:
         _prior = _base_prior;
     }
 
+    // only for a thread holds no lock, it drops any boost.
     inline void
     base_prior(uint32_t bpr) {
         _base_prior = bpr;
+        _eff_prior  = bpr;
+    }
+
+    inline void
+    eff_prior(uint32_t epr) {
+        _eff_prior = epr;
     }
 
     inline void
     cast_magic() {
         _magic = TH_MAGIC;
     }
+
+    inline void
+    dash_magic() {
+        _magic = 0;
+    }
     
 private:
     // now allow to instantialize
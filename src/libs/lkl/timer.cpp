@@ -0,0 +1,194 @@
+#include <timer.h>
+#include <thread.h>
+#include <tskmgr.h>
+#include <intmgr.h>
+#include <pit.h>
+
+ns_lite_kernel_lib_begin
+
+volatile uint32_t timer_mgr::s_ticks = 0;
+uint64_t          timer_mgr::s_ticks64 = 0;
+seqlock_t         timer_mgr::s_tick_seq;
+uint32_t          timer_mgr::s_freq  = TMR_DEF_FREQ;
+heap_t<thread_t, timer_mgr::wakeup_less> timer_mgr::s_sleep_heap;
+uint32_t          timer_mgr::s_irqs         = 0;
+bool              timer_mgr::s_tickless     = false;
+uint32_t          timer_mgr::s_cnt_per_tick = 0;
+uint32_t          timer_mgr::s_max_shot     = 1;
+uint32_t          timer_mgr::s_armed_cnt    = 0;
+uint32_t          timer_mgr::s_shot_cnt     = 0;
+
+void
+timer_mgr::init(uint32_t freq)
+{
+    if(freq < TMR_MIN_FREQ) {
+        freq = TMR_MIN_FREQ;
+    } else if(freq > TMR_MAX_FREQ) {
+        freq = TMR_MAX_FREQ;
+    }
+
+    intr_guard guard(false);
+    s_freq         = freq;
+    s_cnt_per_tick = pit8253::PIT_INPUT_FREQ / freq;
+    s_max_shot     = 0xFFFF / s_cnt_per_tick;
+    s_tickless     = false;
+    pit8253::instance().freq((uint16_t)freq);
+    intr_mgr::instance().reg(
+        intr_mgr::IRQ_NAME_TIMER,
+        timer_mgr::on_tick);
+}
+
+void
+timer_mgr::tickless(bool on)
+{
+    intr_guard guard(false);
+    if(on == s_tickless) {
+        return;
+    }
+
+    s_tickless = on;
+    if(on) {
+        __inner_arm(1, 0);
+    } else {
+        pit8253::instance().freq((uint16_t)s_freq);
+    }
+}
+
+void
+timer_mgr::on_tick(uint32_t vct)
+{
+    ++s_irqs;
+
+    uint32_t n = 1;
+    if(s_tickless) {
+        n = s_armed_cnt / s_cnt_per_tick;
+        // no shot in flight, '__inner_rearm' leaves PIT alone
+        s_armed_cnt = 0;
+    }
+    // interrupt is off in ISR, no guard needed
+    s_tick_seq.write_begin();
+    s_ticks   = s_ticks + n;
+    s_ticks64 = s_ticks64 + n;
+    s_tick_seq.write_end();
+    __inner_wake_expired();
+
+    // arm before scheduler, it might switch to another thread and
+    // we don't come back here until this thread runs again.
+    if(s_tickless) {
+        __inner_arm(__inner_next_event(), 0);
+    }
+    task_mgr::tick(n);
+}
+
+uint32_t
+timer_mgr::ms_to_ticks(uint32_t ms)
+{
+    // ms * freq overflows easily, split it into seconds and the rest.
+    uint32_t sec = ms / TMR_MS_PER_SEC;
+    uint32_t rem = ms % TMR_MS_PER_SEC;
+    return sec * s_freq +
+           (rem * s_freq + TMR_MS_PER_SEC - 1) / TMR_MS_PER_SEC;
+}
+
+bool
+timer_mgr::wakeup_less::operator()(
+    const thread_t* a,
+    const thread_t* b) const
+{
+    return (int32_t)(a->wakeup() - b->wakeup()) < 0;
+}
+
+void
+timer_mgr::__inner_add_sleeper(thread_t* th, uint32_t dl)
+{
+    ASSERT(th->_snode.alone());
+    th->_wakeup = dl;
+    s_sleep_heap.push(th->snode_ptr());
+
+    // new earliest deadline
+    if(s_sleep_heap.top() == th->snode_ptr()) {
+        __inner_rearm();
+    }
+}
+
+void
+timer_mgr::__inner_del_sleeper(thread_t* th)
+{
+    s_sleep_heap.remove(th->snode_ptr());
+}
+
+void
+timer_mgr::__inner_wake_expired()
+{
+    while(s_sleep_heap.empty() == false &&
+          expired((*s_sleep_heap.top())->_wakeup))
+    {
+        auto th = s_sleep_heap.pop()->get();
+
+        // it might be woken up already and waiting to run
+        if(th->is_blocked() == false) {
+            continue;
+        }
+
+        if(th->_waitq != nullptr) {
+            th->_waitq->remove(th->node_ptr());
+            th->_waitq = nullptr;
+        }
+        th->_timed_out = true;
+        task_mgr::unblock_thread(th);
+    }
+}
+
+uint32_t
+timer_mgr::__inner_next_event()
+{
+    if(task_mgr::has_ready()) {
+        return 1;
+    }
+
+    uint32_t n = s_max_shot;
+    if(s_sleep_heap.empty() == false) {
+        int32_t left = (*s_sleep_heap.top())->_wakeup - s_ticks;
+        if(left < 1) {
+            left = 1;
+        }
+        if((uint32_t)left < n) {
+            n = left;
+        }
+    }
+    return n;
+}
+
+void
+timer_mgr::__inner_arm(uint32_t n, uint32_t elapsed)
+{
+    // end on a tick boundary, so that a shot is always whole ticks
+    uint32_t end = (elapsed / s_cnt_per_tick + n) * s_cnt_per_tick;
+    s_armed_cnt  = end;
+    s_shot_cnt   = end - elapsed;
+    pit8253::instance().oneshot((uint16_t)s_shot_cnt);
+}
+
+void
+timer_mgr::__inner_rearm()
+{
+    if(s_tickless == false || s_armed_cnt == 0) {
+        return;
+    }
+
+    uint32_t left = pit8253::instance().count();
+    // shot is over, the interrupt is on its way and rearms anyway.
+    // mode 0 counter wraps around after reaching 0.
+    if(left == 0 || left > s_shot_cnt) {
+        return;
+    }
+
+    uint32_t elapsed = s_armed_cnt - left;
+    uint32_t n       = __inner_next_event();
+    uint32_t end     = (elapsed / s_cnt_per_tick + n) * s_cnt_per_tick;
+    if(end < s_armed_cnt) {
+        __inner_arm(n, elapsed);
+    }
+}
+
+ns_lite_kernel_lib_end
@@ -0,0 +1,156 @@
+#pragma once
+#include <lkl.h>
+#include <heap.h>
+#include <seqlock.h>
+
+ns_lite_kernel_lib_begin
+
+class thread_t;
+
+/*
+ * timer_mgr owns IRQ0. every tick it bumps the global tick counter,
+ * wakes up threads whose deadlines have come and charges the tick to
+ * the running thread via 'task_mgr::tick'.
+ *
+ * sleeping threads are kept in a pairing heap by wake-up tick, so the
+ * ISR only looks at the top. going to sleep is O(1), waking up and
+ * cancelling O(log n). threads of the same deadline wake up in the
+ * same tick, in no particular order.
+ *
+ * ticks wrap around, deadlines are compared by signed difference.
+ * 'ticks64' doesn't wrap, it's two words updated by the ISR so readers
+ * go through 's_tick_seq'.
+ *
+ * TICKLESS MODE:
+ * periodic mode (PIT mode 2) interrupts every tick no matter what.
+ * in tickless mode PIT runs in mode 0 and is armed for next tick that
+ * matters: one tick while other threads are ready (time slicing needs
+ * it), otherwise the earliest sleeper. a thread becomes ready pulls a
+ * far shot in. the interrupt that ends a shot accounts all its ticks.
+ * a 16-bit counter can't wait longer than 65535 input clocks (~55ms),
+ * so an idle system still takes ~18 interrupts per second.
+ */
+class timer_mgr
+{
+    friend class task_mgr;
+public:
+    enum
+    {
+        TMR_DEF_FREQ   = 100,  // 10ms per tick
+        TMR_MIN_FREQ   = 19,   // PIT counter is 16-bit
+        TMR_MAX_FREQ   = 0xFFFF,
+        TMR_MS_PER_SEC = 1000
+    };
+private:
+    static volatile uint32_t s_ticks;
+    static uint64_t          s_ticks64;
+    static seqlock_t         s_tick_seq;
+    static uint32_t          s_freq;
+    // earliest deadline on top, deadlines wrap, so don't use '<'
+    struct wakeup_less
+    {
+        bool operator()(const thread_t* a, const thread_t* b) const;
+    };
+    static heap_t<thread_t, wakeup_less> s_sleep_heap;
+    // timer interrupts taken, equals to ticks in periodic mode
+    static uint32_t          s_irqs;
+    static bool              s_tickless;
+    static uint32_t          s_cnt_per_tick;  // PIT clocks per tick
+    static uint32_t          s_max_shot;      // ticks, PIT count limit
+    // PIT clocks since last interrupt when current shot ends, always
+    // a whole number of ticks. 's_shot_cnt' was written to PIT.
+    static uint32_t          s_armed_cnt;
+    static uint32_t          s_shot_cnt;
+public:
+    // program PIT channel 0 with 'freq' HZ and take over IRQ0.
+    // IRQ0 still has to be unmasked on PIC.
+    static void
+    init(uint32_t freq = TMR_DEF_FREQ);
+
+    // ISR of IRQ0
+    static void
+    on_tick(uint32_t vct);
+
+    static inline uint32_t
+    ticks() {
+        return s_ticks;
+    }
+
+    static inline uint64_t
+    ticks64() {
+        uint32_t seq;
+        uint64_t t;
+        do {
+            seq = s_tick_seq.read_begin();
+            t   = s_ticks64;
+        } while(s_tick_seq.read_retry(seq));
+        return t;
+    }
+
+    static inline uint32_t
+    freq() {
+        return s_freq;
+    }
+
+    static inline uint32_t
+    irqs() {
+        return s_irqs;
+    }
+
+    static inline bool
+    tickless() {
+        return s_tickless;
+    }
+
+    // switch between one-shot (tickless) and periodic mode
+    static void
+    tickless(bool on);
+
+    // round up, a non-zero 'ms' is never less than a tick.
+    static uint32_t
+    ms_to_ticks(uint32_t ms);
+
+    // tick at which 'ms' from now has passed. the tick in progress is
+    // partly gone already, so one more tick is added.
+    static inline uint32_t
+    deadline(uint32_t ms) {
+        return s_ticks + ms_to_ticks(ms) + 1;
+    }
+
+    static inline bool
+    expired(uint32_t dl) {
+        return (int32_t)(s_ticks - dl) >= 0;
+    }
+
+protected:
+    // interrupt must be off
+    static void
+    __inner_add_sleeper(thread_t* th, uint32_t dl);
+
+    // interrupt must be off, nothing happens if 'th' isn't sleeping.
+    static void
+    __inner_del_sleeper(thread_t* th);
+
+    static void
+    __inner_wake_expired();
+
+    // ticks to next interrupt that matters
+    static uint32_t
+    __inner_next_event();
+
+    // arm a shot of 'n' ticks from last interrupt, 'elapsed' PIT
+    // clocks of which have passed.
+    static void
+    __inner_arm(uint32_t n, uint32_t elapsed);
+
+    // pull current shot in if something needs a tick earlier.
+    // interrupt must be off.
+    static void
+    __inner_rearm();
+
+private:
+    // creating an instance is disallowed
+    timer_mgr() = delete;
+};
+
+ns_lite_kernel_lib_end
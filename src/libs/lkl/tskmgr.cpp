@@ -3,6 +3,8 @@
 #include <memory.h>
 #include <x86/asm.h>
 #include <intmgr.h>
+#include <timer.h>
+#include <softirq.h>
 
 extern "C" void __task_switch(
     uint32_t* __th1_stack,
@@ -109,8 +111,18 @@ struct thread_stack
 // Task Manager
 
 uint32_t          task_mgr::s_states = 0;
-queue_t<thread_t> task_mgr::s_rdy_queue;
+queue_t<thread_t> task_mgr::s_rdy_queues[TMC_PRIOR_LEVELS];
+uint32_t          task_mgr::s_rdy_levels = 0;
 queue_t<thread_t> task_mgr::s_all_queue;
+queue_t<thread_t> task_mgr::s_dead_queue;
+queue_t<thread_t> task_mgr::s_tcb_cache;
+uint32_t          task_mgr::s_tcb_cached  = 0;
+thread_t*         task_mgr::s_main_thread = nullptr;
+thread_t*         task_mgr::s_idle_thread = nullptr;
+cycle_stats_t     task_mgr::s_wake_stats;
+cycle_stats_t     task_mgr::s_switch_stats;
+uint64_t          task_mgr::s_switch_at = 0;
+bool              task_mgr::s_need_resched = false;
 
 // why do we have this rather than invoking 'thread function'
 // directly? before 'thread function' runs, kernel has work to do.
@@ -124,6 +136,8 @@ prep_ent_thread(
 {
     x86_asm::turn_interrupt_on();
     func(arg);
+    // a thread ends when its function returns
+    task_mgr::exit_thread();
 }
 
 void
@@ -137,10 +151,14 @@ task_mgr::init()
     // main thread initialized.
     __inner_cur_thrd_as_main_thrd();
 
-    // register scheduler as ISR for 
-    // interrupt<x86_asm>::reg(
-    //     pic8259a::DEV_TIMER,
-    //     task_mgr::scheduler);
+    // lowest priority, it doesn't matter. scheduler treats it as a
+    // fallback rather than a ready thread.
+    s_idle_thread = __inner_create_thread(__inner_idle, nullptr, "idle", 0);
+    ASSERT(s_idle_thread != nullptr);
+    s_all_queue.push_back(s_idle_thread->anode_ptr());
+    bit_set(s_states, TMS_INITIALIZED, true);
+
+    // 'scheduler' is driven by timer_mgr::on_tick, see timer_mgr::init
 }
 
 thread_t* task_mgr::current_thread() {
@@ -151,27 +169,44 @@ thread_t* task_mgr::current_thread() {
 void 
 task_mgr::scheduler(uint32_t no) 
 {
+    tick(1);
+}
 
+void
+task_mgr::tick(uint32_t n)
+{
     auto cur = current_thread();
 
     // ASSERT(s_all_queue.find(&cur->get_alq_node()));
 
-    if(s_rdy_queue.empty()) {
+    // '_prior' counts ticks left in time slice
+    cur->prior(cur->prior() > n ? cur->prior() - n : 0);
+
+    int32_t top = __inner_top_level();
+    if(top < 0) {
         // no need to turn interrupt on, iret will restore eflags later
         return;
     }
 
-    if(cur->is_running()) {
-        cur->state(thread_t::TS_READY);
-        s_rdy_queue.push_back(&cur->node());
+    // any ready thread takes over idle thread
+    if(cur == s_idle_thread) {
+        __inner_preempt();
+        return;
+    }
+
+    // keep running unless a higher priority is ready or time slice is
+    // used up while same priority is waiting.
+    uint32_t lvl = cur->eff_prior();
+    if((uint32_t)top < lvl ||
+       ((uint32_t)top == lvl && cur->prior() > 0))
+    {
+        return;
     }
 
-    auto node = s_rdy_queue.pop_front();
-    (*node)->state(thread_t::TS_RUNNING);
-    task_switch(cur, node->get());
+    __inner_preempt();
 }
 
-bool
+uint32_t
 task_mgr::begin_thread(
     thread_func func,
     void*       arg,
@@ -180,15 +215,37 @@ task_mgr::begin_thread(
 {
     ASSERT(func != nullptr);
     if(func == nullptr) {
-        return false;
+        return 0;
     }
 
-    auto th    = (thread_t*)mem_mgr::alloc(mem_mgr::PT_KERNEL, 1);
+    __inner_reap();
+    auto th = __inner_create_thread(func, arg, name, prior);
+    if(th == nullptr) {
+        return 0;
+    }
+
+    intr_guard guard(false);
+    __inner_push_ready(th);
+    s_all_queue.push_back(th->anode_ptr());
+    return th->tid();
+}
+
+thread_t*
+task_mgr::__inner_create_thread(
+    thread_func func,
+    void*       arg,
+    const char* name,
+    uint32_t    prior)
+{
+    auto th    = __inner_alloc_tcb();
     
     if(th == nullptr) {
-        return false;
+        return nullptr;
     }
 
+    // page might be reused or fresh, either way it holds garbage
+    memset((void*)th, 0, sizeof(thread_t));
+
     auto addr  = (uint32_t)th + PAGE_SIZE;
          addr -= sizeof(intr_stack);
          addr -= sizeof(thread_stack);
@@ -205,16 +262,89 @@ task_mgr::begin_thread(
         th->name(name);
     }
     
-    th->base_prior(TMC_BASE_PRIOR);
+    th->base_prior(prior < TMC_PRIOR_LEVELS ?
+                   prior :
+                   TMC_PRIOR_LEVELS - 1);
     th->reset_prior();
     th->kstack((uint32_t*)addr);
     th->state(thread_t::TS_READY);
     
     th->node().reset(th);
     th->anode().reset(th);
+    th->_snode.reset(th);
     th->cast_magic();
-    s_rdy_queue.push_back(th->node_ptr());
-    s_all_queue.push_back(th->anode_ptr());
+    return th;
+}
+
+void
+task_mgr::__inner_idle(void* arg)
+{
+    while(true) {
+        // check and halt with interrupt off, otherwise a thread becomes
+        // ready right after the check would wait for next interrupt.
+        x86_asm::turn_interrupt_off();
+        // work left behind by an ISR that switched threads
+        softirq_mgr::run();
+        if(s_rdy_levels != 0) {
+            __inner_schedule();
+            x86_asm::turn_interrupt_on();
+        } else {
+            x86_asm::wait_for_interrupt();
+        }
+    }
+}
+
+void
+task_mgr::exit_thread()
+{
+    x86_asm::turn_interrupt_off();
+
+    auto cur = current_thread();
+    // main thread runs on loader's stack, which is not a TCB page.
+    ASSERT(cur != s_main_thread && "main thread cannot exit.");
+
+    // wake up all threads waiting for this one
+    while(cur->_joiners.empty() == false) {
+        auto th = cur->_joiners.pop_front()->get();
+        th->_join_done = true;
+        th->state(thread_t::TS_READY);
+        __inner_push_ready(th);
+    }
+
+    // it cannot free its own page, it's still running on it.
+    // the page is recycled by '__inner_reap' in another thread.
+    cur->state(thread_t::TS_EXITED);
+    s_dead_queue.push_back(cur->node_ptr());
+    __inner_schedule();
+
+    PANIC("exited thread was scheduled again.");
+}
+
+bool
+task_mgr::join(uint32_t tid)
+{
+    {
+        intr_guard guard(false);
+
+        auto cur = current_thread();
+        auto th  = __inner_find_thread(tid);
+        if(th == nullptr || th == cur) {
+            return false;
+        }
+
+        // once it exits its TCB can be reaped and unmapped by any
+        // thread, so don't touch it after waking up. exit_thread
+        // tells us through '_join_done'.
+        if(th->is_exited() == false) {
+            cur->_join_done = false;
+            th->_joiners.push_back(cur->node_ptr());
+            while(cur->_join_done == false) {
+                block_current_thread();
+            }
+        }
+    }
+
+    __inner_reap();
     return true;
 }
 
@@ -223,7 +353,40 @@ task_mgr::block_current_thread()
 {
     ASSERT(x86_asm::is_interrupt_on() == false);
     current_thread()->state(thread_t::TS_BLOCKED);
-    scheduler(0);
+    __inner_schedule();
+}
+
+bool
+task_mgr::block_until(uint32_t dl, queue_t<thread_t>* wq)
+{
+    ASSERT(x86_asm::is_interrupt_on() == false);
+
+    auto cur = current_thread();
+    cur->_waitq     = wq;
+    cur->_timed_out = false;
+    timer_mgr::__inner_add_sleeper(cur, dl);
+
+    block_current_thread();
+
+    // woken up by someone else, deadline is still in sleep queue
+    timer_mgr::__inner_del_sleeper(cur);
+    cur->_waitq = nullptr;
+    return cur->_timed_out == false;
+}
+
+void
+task_mgr::sleep(uint32_t ms)
+{
+    if(ms == 0) {
+        return;
+    }
+
+    intr_guard guard(false);
+    uint32_t dl = timer_mgr::deadline(ms);
+    // nobody else wakes a sleeping thread, but do not count on that.
+    while(timer_mgr::expired(dl) == false) {
+        block_until(dl);
+    }
 }
 
 void
@@ -237,9 +400,94 @@ task_mgr::unblock_thread(thread_t* th)
     intr_guard guard(false);
     
     th->state(thread_t::TS_READY);
-    s_rdy_queue.push_back(th->node_ptr());
+    th->_ready_at = clock_mgr::cycles();
+    __inner_push_ready(th);
+}
+
+uint32_t
+task_mgr::unblock_all(queue_t<thread_t>& wq)
+{
+    intr_guard guard(false);
+    if(wq.empty()) {
+        return 0;
+    }
+
+    uint64_t now  = clock_mgr::cycles();
+    uint32_t lvl  = (*wq.head())->eff_prior();
+    uint32_t cnt  = wq.size();
+    bool     same = true;
+    for(auto th : wq) {
+        ASSERT(th->is_magic_dashed() == false && th->is_blocked());
+        th->state(thread_t::TS_READY);
+        th->_ready_at = now;
+        same = same && th->eff_prior() == lvl;
+    }
+
+    if(same) {
+        s_rdy_queues[lvl].splice_back(wq);
+        s_rdy_levels |= 1u << lvl;
+    } else {
+        while(wq.empty() == false) {
+            auto th = wq.pop_front()->get();
+            s_rdy_queues[th->eff_prior()].push_back(th->node_ptr());
+            s_rdy_levels |= 1u << th->eff_prior();
+        }
+    }
+
+    timer_mgr::__inner_rearm();
+    return cnt;
 }
 
+void
+task_mgr::set_eff_prior(thread_t* th, uint32_t pr)
+{
+    ASSERT(x86_asm::is_interrupt_on() == false);
+    ASSERT(pr < TMC_PRIOR_LEVELS);
+
+    uint32_t old = th->eff_prior();
+    if(old == pr) {
+        return;
+    }
+
+    // idle thread is never in a ready queue
+    if(th->is_ready() && th != s_idle_thread) {
+        auto& queue = s_rdy_queues[old];
+        queue.remove(th->node_ptr());
+        if(queue.empty()) {
+            s_rdy_levels &= ~(1u << old);
+        }
+        th->eff_prior(pr);
+        __inner_push_ready(th);
+    } else {
+        th->eff_prior(pr);
+    }
+}
+
+void
+task_mgr::resched()
+{
+    ASSERT(x86_asm::is_interrupt_on() == false);
+
+    auto cur = current_thread();
+    if(cur != s_idle_thread &&
+       __inner_top_level() > (int32_t)cur->eff_prior())
+    {
+        __inner_preempt();
+    }
+}
+
+void
+task_mgr::resched_deferred()
+{
+    ASSERT(x86_asm::is_interrupt_on() == false);
+
+    if(s_need_resched == false) {
+        return;
+    }
+    s_need_resched = false;
+    // ticks were charged already, decide again as 'tick' would
+    tick(0);
+}
 
 // bool
 // task_mgr::create_process(uint32_t func)
@@ -305,13 +553,166 @@ task_mgr::__inner_cur_thrd_as_main_thrd() {
     // 'task_switch' function will replace it with a correct value
     th->kstack((uint32_t*)((uint32_t)th + 0x1000));
 
+    th->base_prior(TMC_BASE_PRIOR);
+    th->reset_prior();
     th->state(thread_t::TS_RUNNING);
     th->cast_magic();
+    s_main_thread = th;
     th->node().reset(th);
     th->anode().reset(th);
+    th->_snode.reset(th);
     s_all_queue.push_back(th->anode_ptr());
 }
 
+void
+task_mgr::__inner_reap()
+{
+    while(true) {
+        thread_t* th = nullptr;
+        {
+            intr_guard guard(false);
+            auto node = s_dead_queue.pop_front();
+            if(node == nullptr) {
+                return;
+            }
+
+            th = node->get();
+            s_all_queue.remove(th->anode_ptr());
+            th->dash_magic();
+
+            if(s_tcb_cached < TMC_TCB_CACHE) {
+                s_tcb_cache.push_back(th->node_ptr());
+                ++s_tcb_cached;
+                continue;
+            }
+        }
+        // mem_mgr takes a lock, do it with interrupt on
+        mem_mgr::free(mem_mgr::PT_KERNEL, th, 1);
+    }
+}
+
+thread_t*
+task_mgr::__inner_alloc_tcb()
+{
+    {
+        intr_guard guard(false);
+        auto node = s_tcb_cache.pop_front();
+        if(node != nullptr) {
+            --s_tcb_cached;
+            return node->get();
+        }
+    }
+    return (thread_t*)mem_mgr::alloc(mem_mgr::PT_KERNEL, 1);
+}
+
+thread_t*
+task_mgr::__inner_find_thread(uint32_t tid)
+{
+    auto itr = s_all_queue.head();
+    while(itr != nullptr) {
+        if((*itr)->tid() == tid) {
+            return itr->get();
+        }
+        itr = itr->next();
+    }
+    return nullptr;
+}
+
+void
+task_mgr::__inner_preempt()
+{
+    if(softirq_mgr::running()) {
+        s_need_resched = true;
+        return;
+    }
+    __inner_schedule();
+}
+
+void
+task_mgr::__inner_schedule()
+{
+    ASSERT(softirq_mgr::running() == false && "softirq drain switched out.");
+
+    auto cur  = current_thread();
+    auto next = __inner_pop_ready();
+
+    if(next == nullptr) {
+        // nothing else to run
+        if(cur->is_running()) {
+            return;
+        }
+        // current thread blocked or exited, there's always idle thread
+        // to switch to.
+        next = s_idle_thread;
+        ASSERT(next != nullptr && next != cur);
+    }
+
+    if(cur == s_idle_thread) {
+        cur->state(thread_t::TS_READY);
+    } else if(cur->is_running()) {
+        // a thread used up its time slice goes to the back of its
+        // level with a new slice, a preempted one stays at the front.
+        bool expired = cur->prior() == 0;
+        if(expired) {
+            cur->reset_prior();
+        }
+        cur->state(thread_t::TS_READY);
+        __inner_push_ready(cur, !expired);
+    }
+
+    if(next->_ready_at != 0) {
+        s_wake_stats.add(
+            (uint32_t)(clock_mgr::cycles() - next->_ready_at));
+        next->_ready_at = 0;
+    }
+
+    // an ISR switching threads doesn't get back to its end until this
+    // thread runs again.
+    intr_mgr::cancel_timing();
+
+    next->state(thread_t::TS_RUNNING);
+    s_switch_at = clock_mgr::cycles();
+    task_switch(cur, next);
+
+    // running as the thread switched to. a new thread starts elsewhere
+    // and never gets here, its switch isn't counted.
+    if(s_switch_at != 0) {
+        s_switch_stats.add((uint32_t)(clock_mgr::cycles() - s_switch_at));
+        s_switch_at = 0;
+    }
+}
+
+void
+task_mgr::__inner_push_ready(thread_t* th, bool front)
+{
+    uint32_t lvl = th->eff_prior();
+    if(front) {
+        s_rdy_queues[lvl].push_front(th->node_ptr());
+    } else {
+        s_rdy_queues[lvl].push_back(th->node_ptr());
+    }
+    s_rdy_levels |= 1u << lvl;
+
+    // a tickless timer might be far away, time slicing needs ticks now
+    timer_mgr::__inner_rearm();
+}
+
+thread_t*
+task_mgr::__inner_pop_ready()
+{
+    int32_t top = __inner_top_level();
+    if(top < 0) {
+        return nullptr;
+    }
+
+    auto& queue = s_rdy_queues[top];
+    auto  node  = queue.pop_front();
+    if(queue.empty()) {
+        s_rdy_levels &= ~(1u << top);
+    }
+    return node->get();
+}
+
 // 
 // -----------------------------------------------------------------------
 
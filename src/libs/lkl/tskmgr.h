@@ -1,6 +1,8 @@
 #pragma once
 #include <lkl.h>
 #include <queue.h>
+#include <bit.h>
+#include <clock.h>
 
 ns_lite_kernel_lib_begin
 
@@ -10,29 +12,64 @@ typedef void (*thread_func)(void* arg);
 
 class task_mgr
 {
-private:
-    static uint32_t          s_states;
-    static queue_t<thread_t> s_rdy_queue;
-    static queue_t<thread_t> s_all_queue;
 public:
     enum
     {
         TMS_INITIALIZED = 0x00000001,
         TMS_MAIN_THREAD = 0x00000002,
-        TMC_BASE_PRIOR  = 30
+        TMC_PRIOR_LEVELS= 32, // priority 0 (lowest) - 31 (highest)
+        TMC_BASE_PRIOR  = 30,
+        TMC_TCB_CACHE   = 8   // reaped TCB pages kept for reuse
     };
+private:
+    static uint32_t          s_states;
+    // one ready queue per priority, bit 'n' of 's_rdy_levels' is set
+    // if 's_rdy_queues[n]' is not empty.
+    static queue_t<thread_t> s_rdy_queues[TMC_PRIOR_LEVELS];
+    static uint32_t          s_rdy_levels;
+    static queue_t<thread_t> s_all_queue;
+    // exited threads, their pages are still in use until reaped
+    static queue_t<thread_t> s_dead_queue;
+    // reaped TCB pages ready for 'begin_thread'
+    static queue_t<thread_t> s_tcb_cache;
+    static uint32_t          s_tcb_cached;
+    static thread_t*         s_main_thread;
+    // runs only if no other thread is ready, never in a ready queue.
+    static thread_t*         s_idle_thread;
+    // cycles from 'unblock_thread' until the thread runs
+    static cycle_stats_t     s_wake_stats;
+    // cycles from leaving a thread until the next one runs. stamped
+    // before '__task_switch', added by the thread switched to.
+    static cycle_stats_t     s_switch_stats;
+    static uint64_t          s_switch_at;
+    // a switch 'tick' or 'resched' wanted while softirqs were running,
+    // done once the drain ends. see '__inner_preempt'.
+    static bool              s_need_resched;
 public:
     static void
     init();
     
-    // 'scheduler' is an ISR for 'timer'
+    // 'scheduler' is an ISR for 'timer', same as tick(1).
     static void
     scheduler(uint32_t no /*never used*/);
 
+    // charges 'n' ticks to running thread, switches to another one if
+    // a higher priority is ready or time slice is used up.
+    // a tickless timer passes all ticks elapsed since last interrupt.
+    static void
+    tick(uint32_t n);
+
+    // any thread ready to run other than current one
+    static inline bool
+    has_ready() {
+        return s_rdy_levels != 0;
+    }
+
     static thread_t*
     current_thread();
     
-    static bool
+    // return tid of new thread, 0 if failed
+    static uint32_t
     begin_thread(
         thread_func func,
         void*       arg,
@@ -40,12 +77,65 @@ public:
         uint32_t    prior
     );
 
+    // terminate current thread, never returns.
+    // a thread function returns also ends up here.
+    static void
+    exit_thread();
+
+    // wait until thread 'tid' exits
+    // return false if there's no such thread (never existed or has
+    // been reaped already) or 'tid' is current thread.
+    static bool
+    join(uint32_t tid);
+
     static void
     block_current_thread();
 
+    // block current thread until it's unblocked or tick 'dl' comes.
+    // if '_node' of current thread is in 'wq', timer takes it out on
+    // timeout.
+    // interrupt must be off. return false if timed out.
+    static bool
+    block_until(uint32_t dl, queue_t<thread_t>* wq = nullptr);
+
+    // give up cpu for at least 'ms' milliseconds
+    static void
+    sleep(uint32_t ms);
+
     static void
     unblock_thread(thread_t* th);
 
+    // make every thread in 'wq' ready, 'wq' becomes empty.
+    // threads of the same priority are spliced into the ready queue
+    // at once. return number of threads woken up.
+    static uint32_t
+    unblock_all(queue_t<thread_t>& wq);
+
+    // change effective priority of 'th', it moves to the new level if
+    // it's ready. interrupt must be off.
+    static void
+    set_eff_prior(thread_t* th, uint32_t pr);
+
+    // switch away if a higher priority is ready, after current thread
+    // lost a boost. interrupt must be off.
+    static void
+    resched();
+
+    // do the switch held back while softirqs were running.
+    // called by softirq_mgr after a drain, interrupt must be off.
+    static void
+    resched_deferred();
+
+    static const cycle_stats_t&
+    wake_stats() {
+        return s_wake_stats;
+    }
+
+    static const cycle_stats_t&
+    switch_stats() {
+        return s_switch_stats;
+    }
+
     static bool
     create_process(uint32_t func);
 
@@ -68,6 +158,53 @@ protected:
     static void
     __inner_cur_thrd_as_main_thrd();
 
+    // allocate and initialize a thread, it's not put in any queue.
+    static thread_t*
+    __inner_create_thread(
+        thread_func func,
+        void*       arg,
+        const char* name,
+        uint32_t    prior);
+
+    static void
+    __inner_idle(void* arg);
+
+    // recycle pages of exited threads, keeps up to TMC_TCB_CACHE of
+    // them and gives the rest back to mem_mgr.
+    static void
+    __inner_reap();
+
+    // a TCB page from cache or mem_mgr
+    static thread_t*
+    __inner_alloc_tcb();
+
+    static thread_t*
+    __inner_find_thread(uint32_t tid);
+
+    // switch to the highest priority ready thread
+    static void
+    __inner_schedule();
+
+    // 'front': preempted thread keeps its place in line
+    static void
+    __inner_push_ready(thread_t* th, bool front = false);
+
+    static thread_t*
+    __inner_pop_ready();
+
+    // '__inner_schedule' for preemption. a softirq drain runs on the
+    // interrupted thread's stack, switching it out would park the
+    // drain and stall every work item behind it, so the switch waits
+    // for 'resched_deferred'.
+    static void
+    __inner_preempt();
+
+    // highest level has a ready thread, -1 if none
+    static int32_t
+    __inner_top_level() {
+        return s_rdy_levels != 0 ? (int32_t)bit_msb(s_rdy_levels) : -1;
+    }
+
 private:
     // creating an instance is disallowed
     task_mgr() = delete;  
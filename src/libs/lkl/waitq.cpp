@@ -0,0 +1,48 @@
+#include <waitq.h>
+#include <thread.h>
+#include <tskmgr.h>
+
+ns_lite_kernel_lib_begin
+
+void
+wait_queue_t::sleep()
+{
+    ASSERT(x86_asm::is_interrupt_on() == false);
+    _queue.push_back(task_mgr::current_thread()->node_ptr());
+    task_mgr::block_current_thread();
+}
+
+bool
+wait_queue_t::sleep_until(uint32_t dl)
+{
+    ASSERT(x86_asm::is_interrupt_on() == false);
+    _queue.push_back(task_mgr::current_thread()->node_ptr());
+    return task_mgr::block_until(dl, &_queue);
+}
+
+void
+wait_queue_t::notify_one()
+{
+    // unlocked peek, it's the common case: nobody is waiting.
+    // a waiter that isn't queued yet hasn't checked the state either.
+    if(_queue.empty()) {
+        return;
+    }
+
+    intr_guard guard(false);
+    auto node = _queue.pop_front();
+    if(node != nullptr) {
+        task_mgr::unblock_thread(node->get());
+    }
+}
+
+uint32_t
+wait_queue_t::notify_all()
+{
+    if(_queue.empty()) {
+        return 0;
+    }
+    return task_mgr::unblock_all(_queue);
+}
+
+ns_lite_kernel_lib_end
@@ -0,0 +1,59 @@
+#pragma once
+#include <lkl.h>
+#include <queue.h>
+#include <intmgr.h>
+
+ns_lite_kernel_lib_begin
+
+class thread_t;
+
+/*
+ * threads waiting for a condition that's protected by turning
+ * interrupt off (the monitor of this kernel, there's one cpu).
+ *
+ * waiter checks the condition and goes to sleep with interrupt off,
+ * so a notifier can't get in between and a wake up can't be lost.
+ * notifier changes the state first, then notifies. woken threads check
+ * again (Mesa monitor), someone else might have been there first.
+ */
+class wait_queue_t
+{
+private:
+    queue_t<thread_t> _queue;
+public:
+    inline bool
+    empty() const {
+        return _queue.empty();
+    }
+
+    // put current thread to sleep until notified.
+    // interrupt must be off.
+    void
+    sleep();
+
+    // same as 'sleep' but gives up at tick 'dl'.
+    // return false if timed out.
+    bool
+    sleep_until(uint32_t dl);
+
+    // sleep until 'pred()' is true, 'pred' is called with interrupt off
+    template<typename Pred>
+    void
+    wait(Pred pred) {
+        intr_guard guard(false);
+        while(pred() == false) {
+            sleep();
+        }
+    }
+
+    // wake up first waiter if any
+    void
+    notify_one();
+
+    // wake up all waiters, they are moved to ready queue at once.
+    // return number of threads woken up.
+    uint32_t
+    notify_all();
+};
+
+ns_lite_kernel_lib_end
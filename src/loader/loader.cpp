@@ -102,23 +102,45 @@ void enable_paging(void* addr)
     pge.writable(true);
     pg_dir_t dir((pge_t*)addr, PD_ENT_NUM);
     dir.fill(0, PD_ENT_NUM, pge, 0);
-
-    // fill first PDE
     pge.present(true);
-    pge.address((uint32_t)addr + PAGE_SIZE); // first PTE address
-    dir[0] = pge;
+
+    // first 16MB is identity-mapped (PDE 0-3), it's also mapped to
+    // 0xC0000000-0xC0FFFFFF (PDE 768-771) for kernel.
+    if(x86_asm::has_pse()) {
+        // each PDE maps a 4MB page directly. no page table is needed
+        // and each 4MB takes one TLB entry instead of 1024.
+        pde_t pde = (uint32_t)pge;
+        pde.ps(true);
+        x86_asm::turn_pse_on();
+        dir.fill(0,   4,   pde, LARGE_PAGE_SIZE);
+
+        // kernel half is the same in every address space, keep its
+        // TLB entries across cr3 reloads.
+        pde.global(true);
+        dir.fill(768, 772, pde, LARGE_PAGE_SIZE);
+    } else {
+        // 4 page tables follow page directory (addr+0x1000-0x4FFF)
+        pge.address((uint32_t)addr + PAGE_SIZE); // first PTE address
+        dir.fill(0,   4,   pge);
+        dir.fill(768, 772, pge);
+
+        // fill page tables, they're contiguous
+        dir.reset((pge_t*)((uint32_t)addr + PAGE_SIZE), PT_ENT_NUM * 4);
+        pge.address(0); // 0x00000000 -> 0x01000000;
+        dir.fill(0, PT_ENT_NUM * 4, pge);
+        dir.reset((pge_t*)addr, PD_ENT_NUM);
+    }
 
     // last PDE
     pge.address((uint32_t)addr);
     dir[PD_ENT_NUM-1] = pge;
 
-    // fill first page table
-    dir.reset((pge_t*)((uint32_t)addr + PAGE_SIZE), PT_ENT_NUM);
-    pge.address(0); // 0x00000000 -> 0x00400000;
-    dir.fill(0, PT_ENT_NUM, pge);
-
     x86_asm::set_cr3((uint32_t)addr);
     x86_asm::turn_paging_on();
+
+    if(x86_asm::has_pge()) {
+        x86_asm::turn_pge_on();
+    }
 }
 
 /*
@@ -228,7 +250,10 @@ int main() {
     // task_mgr::init();
     // pic8259a::enable(pic8259a::DEV_TIMER);
     
-    // pit8253::freq(4000);
+    // clock_mgr::init();
+    // intr_mgr::enable_stats(true);
+    // timer_mgr::init(100);
+    // timer_mgr::tickless(true);
     // task_mgr::begin_thread(thread_a, nullptr, "thA", 5);
     // task_mgr::begin_thread(thread_b, nullptr, "thB", 10);
 
@@ -243,6 +268,10 @@ int main() {
     //         } 
     //     }
     // }
-    while(1);
+
+    // nothing left to do, don't spin
+    while(1) {
+        x86_asm::halt();
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+
+/*
+ * shared bits of hosted tests.
+ *
+ * header-only lkl containers are built for the host with only
+ * 'src/libs/lkl' on the include path, host's <stdint.h> stands in for
+ * ours. each test is a single translation unit, so 'panic_spin' is
+ * defined right here: a failed ASSERT in lkl code aborts the test.
+ */
+
+extern "C" void
+panic_spin(
+    const char* filename,
+    int         line,
+    const char* func,
+    const char* condition)
+{
+    std::fprintf(stderr, "%s:%d: %s: %s\n", filename, line, func, condition);
+    std::abort();
+}
+
+#define CHECK(CONDITION)                                            \
+    do {                                                            \
+        if (!(CONDITION)) {                                         \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n",       \
+                         __FILE__, __LINE__, #CONDITION);           \
+            std::exit(1);                                           \
+        }                                                           \
+    } while (0)
+
+// run one test function and report it
+#define RUN(TEST)                                                   \
+    do {                                                            \
+        TEST();                                                     \
+        std::printf("  %-32s ok\n", #TEST);                         \
+    } while (0)
+
+// nanoseconds per operation of whatever ran since 'beg'
+inline double
+ns_per_op(std::chrono::steady_clock::time_point beg, uint32_t ops)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - beg).count();
+    return (double)ns / ops;
+}
@@ -0,0 +1,220 @@
+#include "check.h"
+#include <heap.h>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+using lkl::heap_t;
+using lkl::hnode_t;
+
+namespace {
+
+struct obj_t
+{
+    uint32_t        key = 0;
+    hnode_t<obj_t>  nd;
+
+    obj_t() : nd(this) { }
+
+    bool operator<(const obj_t& other) const {
+        return key < other.key;
+    }
+};
+
+// wrap-safe order of tick deadlines, as timer_mgr sorts sleepers
+struct wrap_less
+{
+    bool operator()(const obj_t* a, const obj_t* b) const {
+        return (int32_t)(a->key - b->key) < 0;
+    }
+};
+
+typedef heap_t<obj_t> heap;
+
+// pop everything, keys come out as 'ref' has them
+template<typename H>
+void
+drain(H& hp, std::multiset<uint32_t> ref)
+{
+    CHECK(hp.size() == ref.size());
+    while (hp.empty() == false) {
+        CHECK(hp.valid());
+        auto nd = hp.pop();
+        CHECK(nd->alone());
+        CHECK((*nd)->key == *ref.begin());
+        ref.erase(ref.begin());
+    }
+    CHECK(ref.empty());
+    CHECK(hp.size() == 0 && hp.top() == nullptr && hp.pop() == nullptr);
+}
+
+void
+test_zeroed_heap()
+{
+    alignas(heap) unsigned char buf[sizeof(heap)];
+    std::memset(buf, 0, sizeof(buf));
+    auto& hp = *reinterpret_cast<heap*>(buf);
+    CHECK(hp.empty() && hp.valid());
+
+    obj_t a;
+    a.key = 5;
+    hp.push(&a.nd);
+    CHECK(hp.top() == &a.nd && hp.valid());
+    CHECK(hp.pop() == &a.nd);
+    CHECK(hp.empty() && hp.valid());
+}
+
+void
+test_push_pop()
+{
+    const uint32_t keys[8] = { 5, 3, 8, 1, 9, 3, 7, 2 };
+    obj_t o[8];
+    heap  hp;
+    std::multiset<uint32_t> ref;
+    for (int i = 0; i < 8; ++i) {
+        o[i].key = keys[i];
+        hp.push(&o[i].nd);
+        ref.insert(keys[i]);
+        CHECK(hp.valid());
+        CHECK((*hp.top())->key == *ref.begin());
+    }
+
+    // a linked node isn't pushed again
+    hp.push(&o[0].nd);
+    hp.push(nullptr);
+    CHECK(hp.size() == 8 && hp.valid());
+    drain(hp, ref);
+}
+
+void
+test_remove()
+{
+    obj_t o[16];
+    heap  hp;
+    std::multiset<uint32_t> ref;
+    for (int i = 0; i < 16; ++i) {
+        o[i].key = (i * 7) % 16;
+        hp.push(&o[i].nd);
+        ref.insert(o[i].key);
+    }
+    // build some depth first
+    CHECK((*hp.pop())->key == 0);
+    ref.erase(ref.begin());
+    CHECK(hp.valid());
+
+    // non-root nodes: leftmost children, siblings, inner ones
+    for (int i : { 3, 12, 5, 9, 14 }) {
+        if (o[i].nd.alone()) {
+            continue;
+        }
+        CHECK(hp.top() != &o[i].nd);
+        hp.remove(&o[i].nd);
+        CHECK(o[i].nd.alone());
+        ref.erase(ref.find(o[i].key));
+        CHECK(hp.valid());
+        CHECK(hp.size() == ref.size());
+    }
+
+    // root
+    auto top = hp.top();
+    hp.remove(top);
+    CHECK(top->alone());
+    ref.erase(ref.begin());
+    CHECK(hp.valid());
+
+    // timer_mgr::__inner_del_sleeper removes a thread whether it's
+    // still in the heap or was popped by the timer already
+    uint32_t sz = hp.size();
+    hp.remove(top);
+    hp.remove(&o[3].nd);
+    hp.remove(nullptr);
+    obj_t lone;
+    hp.remove(&lone.nd);
+    CHECK(hp.size() == sz && hp.valid());
+
+    // removed nodes can be pushed again
+    hp.push(&o[3].nd);
+    ref.insert(o[3].key);
+    drain(hp, ref);
+}
+
+void
+test_wrap_order()
+{
+    // deadlines around the 32-bit wrap come out in time order
+    const uint32_t keys[6] = { 0xFFFFFFF0, 0x10, 0xFFFFFFFF, 0x0,
+                               0x5, 0xFFFFFFF8 };
+    const uint32_t sorted[6] = { 0xFFFFFFF0, 0xFFFFFFF8, 0xFFFFFFFF,
+                                 0x0, 0x5, 0x10 };
+    obj_t o[6];
+    heap_t<obj_t, wrap_less> hp;
+    for (int i = 0; i < 6; ++i) {
+        o[i].key = keys[i];
+        hp.push(&o[i].nd);
+    }
+    CHECK(hp.valid());
+    for (int i = 0; i < 6; ++i) {
+        CHECK((*hp.pop())->key == sorted[i]);
+        CHECK(hp.valid());
+    }
+}
+
+// random push/pop/remove against std::multiset
+void
+test_random()
+{
+    const int N = 20000;
+    std::vector<obj_t> o(N);
+    std::multiset<uint32_t> ref;
+    heap hp;
+    std::mt19937 rng(2024);
+
+    for (int round = 0; round < 400000; ++round) {
+        auto& x = o[rng() % N];
+        switch (rng() % 4) {
+        case 0:
+        case 1:
+            if (x.nd.alone()) {
+                x.key = rng() % 5000;
+                hp.push(&x.nd);
+                ref.insert(x.key);
+            }
+            break;
+        case 2:
+            if (hp.empty() == false) {
+                auto nd = hp.pop();
+                CHECK((*nd)->key == *ref.begin());
+                ref.erase(ref.begin());
+            }
+            break;
+        case 3:
+            // member or not, remove must keep the heap right
+            if (x.nd.alone() == false) {
+                ref.erase(ref.find(x.key));
+            }
+            hp.remove(&x.nd);
+            CHECK(x.nd.alone());
+            break;
+        }
+        CHECK(hp.size() == ref.size());
+        if (round % 20000 == 0) {
+            CHECK(hp.valid());
+        }
+    }
+    drain(hp, ref);
+}
+
+} // namespace
+
+int
+main()
+{
+    std::printf("heap_t\n");
+    RUN(test_zeroed_heap);
+    RUN(test_push_pop);
+    RUN(test_remove);
+    RUN(test_wrap_order);
+    RUN(test_random);
+    return 0;
+}
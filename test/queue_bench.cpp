@@ -0,0 +1,132 @@
+#include "check.h"
+#include <queue.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using lkl::queue_t;
+using lkl::qnode_t;
+
+/*
+ * queue_t with 10k nodes: what block/unblock, timed waits and the
+ * ready queues do to it. every operation should cost the same no
+ * matter where the node is. built with NDEBUG, debug builds check
+ * membership in 'remove/insert' with a walk.
+ */
+
+namespace {
+
+struct item_t
+{
+    uint32_t         val = 0;
+    qnode_t<item_t>  nd;
+
+    item_t() : nd(this) { }
+};
+
+const uint32_t N      = 10000;
+const uint32_t ROUNDS = 100;
+
+void
+report(const char* what, double ns)
+{
+    std::printf("  %-36s %8.2f ns/op\n", what, ns);
+}
+
+} // namespace
+
+int
+main()
+{
+    std::vector<item_t> it(N);
+    std::vector<uint32_t> order(N);
+    for (uint32_t i = 0; i < N; ++i) {
+        it[i].val = i;
+        order[i]  = i;
+    }
+    std::mt19937 rng(10000);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    queue_t<item_t> q;
+    queue_t<item_t> other;
+    uint64_t        sum = 0;
+
+    std::printf("queue_t, %u nodes, %u rounds\n", N, ROUNDS);
+
+    // fill and drain from both ends
+    auto beg = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        for (uint32_t i = 0; i < N; ++i) {
+            q.push_back(&it[i].nd);
+        }
+        while (q.empty() == false) {
+            q.pop_front();
+        }
+    }
+    report("push_back + pop_front", ns_per_op(beg, ROUNDS * N * 2));
+
+    // remove in random order, which used to walk the queue first
+    beg = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        for (uint32_t i = 0; i < N; ++i) {
+            q.push_back(&it[i].nd);
+        }
+        for (uint32_t i = 0; i < N; ++i) {
+            q.remove(&it[order[i]].nd);
+        }
+    }
+    CHECK(q.empty());
+    report("push_back + remove (random)", ns_per_op(beg, ROUNDS * N * 2));
+
+    // insert every odd node before its even neighbour, in the middle
+    beg = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        for (uint32_t i = 0; i < N; i += 2) {
+            q.push_back(&it[i].nd);
+        }
+        for (uint32_t i = 1; i < N; i += 2) {
+            q.insert(&it[i - 1].nd, &it[i].nd);
+        }
+        while (q.empty() == false) {
+            q.pop_back();
+        }
+    }
+    report("insert (middle) + pop_back", ns_per_op(beg, ROUNDS * N * 3 / 2));
+
+    // waking a whole level at once
+    beg = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        for (uint32_t i = 0; i < N; ++i) {
+            other.push_back(&it[i].nd);
+        }
+        q.splice_back(other);
+        CHECK(q.size() == N);
+        while (q.empty() == false) {
+            q.pop_front();
+        }
+    }
+    report("push_back + splice_back + pop_front",
+           ns_per_op(beg, ROUNDS * N * 2));
+
+    // walking all objects
+    for (uint32_t i = 0; i < N; ++i) {
+        q.push_back(&it[i].nd);
+    }
+    beg = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        for (item_t* p : q) {
+            sum += p->val;
+        }
+    }
+    report("iterate", ns_per_op(beg, ROUNDS * N));
+    CHECK(sum == (uint64_t)ROUNDS * N * (N - 1) / 2);
+
+    // size is cached
+    beg = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS * N; ++r) {
+        sum += q.size();
+        asm volatile("" : : "r"(&q) : "memory");
+    }
+    report("size", ns_per_op(beg, ROUNDS * N));
+    return 0;
+}
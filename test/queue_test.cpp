@@ -0,0 +1,354 @@
+#include "check.h"
+#include <queue.h>
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <random>
+#include <vector>
+
+using lkl::queue_t;
+using lkl::qnode_t;
+
+namespace {
+
+struct item_t
+{
+    int              val;
+    qnode_t<item_t>  nd;
+
+    item_t() : val(0), nd(this) { }
+    explicit item_t(int v) : val(v), nd(this) { }
+};
+
+typedef queue_t<item_t> queue;
+
+// 'q' holds exactly 'exp' in order: walked forward by iterator and
+// backward by links, size and end links agree.
+void
+expect(const queue& q, const std::vector<int>& exp)
+{
+    CHECK(q.size() == exp.size());
+    CHECK(q.length() == q.size());
+    CHECK(q.empty() == exp.empty());
+    CHECK(q.unique() == (exp.size() == 1));
+
+    size_t i = 0;
+    for (const item_t* it : q) {
+        CHECK(i < exp.size());
+        CHECK(it->val == exp[i]);
+        CHECK(it->nd.alone() == false);
+        ++i;
+    }
+    CHECK(i == exp.size());
+
+    if (exp.empty()) {
+        CHECK(q.head() == nullptr && q.tail() == nullptr);
+        return;
+    }
+    CHECK(q.head()->prev() == nullptr);
+    CHECK(q.tail()->next() == nullptr);
+
+    i = exp.size();
+    for (auto nd = q.tail(); nd != nullptr; nd = nd->prev()) {
+        CHECK(i > 0);
+        --i;
+        CHECK(nd->get()->val == exp[i]);
+        if (nd->next() != nullptr) {
+            CHECK(nd->next()->prev() == nd);
+        }
+    }
+    CHECK(i == 0);
+}
+
+void
+test_zeroed_queue()
+{
+    // TCBs are memset and never constructed
+    alignas(queue) unsigned char buf[sizeof(queue)];
+    std::memset(buf, 0, sizeof(buf));
+    auto& q = *reinterpret_cast<queue*>(buf);
+    expect(q, {});
+
+    item_t a(1);
+    q.push_back(&a.nd);
+    expect(q, {1});
+    CHECK(q.pop_front() == &a.nd);
+    expect(q, {});
+}
+
+void
+test_push_pop()
+{
+    item_t it[4] = { item_t(0), item_t(1), item_t(2), item_t(3) };
+    queue q;
+
+    q.push_back(&it[1].nd);
+    q.push_back(&it[2].nd);
+    q.push_front(&it[0].nd);
+    q.push_back(&it[3].nd);
+    expect(q, {0, 1, 2, 3});
+
+    // a queued node is never pushed twice
+    q.push_back(&it[1].nd);
+    q.push_front(&it[3].nd);
+    expect(q, {0, 1, 2, 3});
+
+    CHECK(q.pop_front() == &it[0].nd);
+    CHECK(it[0].nd.alone());
+    CHECK(it[0].nd.prev() == nullptr && it[0].nd.next() == nullptr);
+    CHECK(q.pop_back() == &it[3].nd);
+    expect(q, {1, 2});
+
+    CHECK(q.pop_back() == &it[2].nd);
+    // a lone queued node has null links but isn't alone
+    CHECK(it[1].nd.alone() == false);
+    expect(q, {1});
+    CHECK(q.pop_back() == &it[1].nd);
+    CHECK(q.pop_front() == nullptr);
+    CHECK(q.pop_back() == nullptr);
+    expect(q, {});
+}
+
+void
+test_remove()
+{
+    item_t it[5] = { item_t(0), item_t(1), item_t(2), item_t(3),
+                     item_t(4) };
+    queue q;
+    for (auto& i : it) {
+        q.push_back(&i.nd);
+    }
+
+    q.remove(&it[2].nd);
+    CHECK(it[2].nd.alone());
+    expect(q, {0, 1, 3, 4});
+
+    q.remove(&it[0].nd);
+    expect(q, {1, 3, 4});
+
+    q.remove(&it[4].nd);
+    expect(q, {1, 3});
+
+    // not in any queue, nothing happens
+    q.remove(&it[2].nd);
+    q.remove(nullptr);
+    expect(q, {1, 3});
+
+    q.remove(&it[1].nd);
+    q.remove(&it[3].nd);
+    expect(q, {});
+
+    // a node removed can be queued again
+    q.push_back(&it[2].nd);
+    expect(q, {2});
+}
+
+void
+test_insert()
+{
+    item_t it[5] = { item_t(0), item_t(1), item_t(2), item_t(3),
+                     item_t(4) };
+    queue q;
+    q.push_back(&it[0].nd);
+    q.push_back(&it[2].nd);
+    q.push_back(&it[4].nd);
+
+    // middle
+    q.insert(&it[2].nd, &it[1].nd);
+    expect(q, {0, 1, 2, 4});
+    q.insert(&it[4].nd, &it[3].nd);
+    expect(q, {0, 1, 2, 3, 4});
+
+    // before head
+    q.remove(&it[0].nd);
+    q.insert(&it[1].nd, &it[0].nd);
+    expect(q, {0, 1, 2, 3, 4});
+
+    // invalid ones are ignored: queued node, position in no queue,
+    // inserting before itself
+    item_t lone(9);
+    q.insert(&it[3].nd, &it[1].nd);
+    q.insert(&lone.nd, &it[0].nd);
+    q.insert(&it[2].nd, &it[2].nd);
+    q.insert(nullptr, &lone.nd);
+    expect(q, {0, 1, 2, 3, 4});
+    CHECK(lone.nd.alone());
+}
+
+void
+test_splice_back()
+{
+    item_t it[6] = { item_t(0), item_t(1), item_t(2), item_t(3),
+                     item_t(4), item_t(5) };
+    queue a;
+    queue b;
+
+    // empty into empty
+    a.splice_back(b);
+    expect(a, {});
+
+    // into empty
+    b.push_back(&it[0].nd);
+    b.push_back(&it[1].nd);
+    a.splice_back(b);
+    expect(a, {0, 1});
+    expect(b, {});
+
+    // into non-empty, nodes stay queued
+    b.push_back(&it[2].nd);
+    b.push_back(&it[3].nd);
+    b.push_back(&it[4].nd);
+    a.splice_back(b);
+    expect(a, {0, 1, 2, 3, 4});
+    expect(b, {});
+    CHECK(it[3].nd.alone() == false);
+
+    // from empty and into itself do nothing
+    a.splice_back(b);
+    a.splice_back(a);
+    expect(a, {0, 1, 2, 3, 4});
+
+    // spliced nodes behave like any other
+    a.remove(&it[2].nd);
+    a.insert(&it[4].nd, &it[5].nd);
+    CHECK(a.pop_back() == &it[4].nd);
+    expect(a, {0, 1, 3, 5});
+
+    // a single node
+    b.push_back(&it[2].nd);
+    a.splice_back(b);
+    expect(a, {0, 1, 3, 5, 2});
+}
+
+void
+test_iterate()
+{
+    item_t it[3] = { item_t(10), item_t(20), item_t(30) };
+    queue q;
+    for (auto& i : it) {
+        q.push_back(&i.nd);
+    }
+
+    int sum = 0;
+    for (item_t* i : q) {
+        i->val += 1;
+        sum += i->val;
+    }
+    CHECK(sum == 63);
+
+    // removing while walking by hand
+    for (auto nd = q.head(); nd != nullptr; ) {
+        auto nxt = nd->next();
+        if ((*nd)->val == 21) {
+            q.remove(nd);
+        }
+        nd = nxt;
+    }
+    expect(q, {11, 31});
+
+    const queue& cq = q;
+    int cnt = 0;
+    for (const item_t* i : cq) {
+        cnt += i->val;
+    }
+    CHECK(cnt == 42);
+}
+
+// random operations against std::list
+void
+test_random()
+{
+    const int N = 2000;
+    std::vector<item_t> it(N);
+    for (int i = 0; i < N; ++i) {
+        it[i].val = i;
+    }
+
+    std::mt19937 rng(23);
+    queue          q;
+    queue          other;
+    std::list<int> ref;
+    std::list<int> ref_other;
+
+    for (int round = 0; round < 100000; ++round) {
+        int  i  = rng() % N;
+        auto nd = &it[i].nd;
+        switch (rng() % 6) {
+        case 0:
+            if (nd->alone()) {
+                q.push_back(nd);
+                ref.push_back(i);
+            }
+            break;
+        case 1:
+            if (nd->alone()) {
+                q.push_front(nd);
+                ref.push_front(i);
+            }
+            break;
+        case 2:
+            // a node in 'other' is removed from there
+            if (nd->alone() == false) {
+                auto pos = std::find(ref.begin(), ref.end(), i);
+                if (pos != ref.end()) {
+                    q.remove(nd);
+                    ref.erase(pos);
+                } else {
+                    other.remove(nd);
+                    ref_other.remove(i);
+                }
+            }
+            break;
+        case 3:
+            if (nd->alone() && q.empty() == false) {
+                auto pos = q.head();
+                for (int k = rng() % 8; k > 0 && pos->next(); --k) {
+                    pos = pos->next();
+                }
+                q.insert(pos, nd);
+                ref.insert(
+                    std::find(ref.begin(), ref.end(), pos->get()->val), i);
+            }
+            break;
+        case 4:
+            if (nd->alone()) {
+                other.push_back(nd);
+                ref_other.push_back(i);
+            }
+            break;
+        case 5:
+            if (rng() % 64 == 0) {
+                q.splice_back(other);
+                ref.splice(ref.end(), ref_other);
+            } else if (q.empty() == false) {
+                CHECK(q.pop_front()->get()->val == ref.front());
+                ref.pop_front();
+            }
+            break;
+        }
+
+        if (round % 10000 == 0) {
+            expect(q, std::vector<int>(ref.begin(), ref.end()));
+            expect(other,
+                   std::vector<int>(ref_other.begin(), ref_other.end()));
+        }
+    }
+    expect(q, std::vector<int>(ref.begin(), ref.end()));
+    expect(other, std::vector<int>(ref_other.begin(), ref_other.end()));
+}
+
+} // namespace
+
+int
+main()
+{
+    std::printf("queue_t\n");
+    RUN(test_zeroed_queue);
+    RUN(test_push_pop);
+    RUN(test_remove);
+    RUN(test_insert);
+    RUN(test_splice_back);
+    RUN(test_iterate);
+    RUN(test_random);
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include "check.h"
+#include <rbtree.h>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+using lkl::rbtree_t;
+using lkl::rbnode_t;
+
+namespace {
+
+struct obj_t
+{
+    uint32_t                  id = 0;
+    rbnode_t<obj_t, uint32_t> nd;
+
+    obj_t() : nd(this) { }
+};
+
+typedef rbtree_t<obj_t, uint32_t> tree;
+
+// 'tr' is a valid red-black tree holding exactly 'ref', walked both
+// ways in key order
+void
+expect(const tree& tr, const std::multiset<uint32_t>& ref)
+{
+    CHECK(tr.valid());
+    CHECK(tr.size() == ref.size());
+    CHECK(tr.empty() == ref.empty());
+
+    auto itr = ref.begin();
+    for (auto nd = tr.first(); nd != nullptr; nd = tree::next(nd)) {
+        CHECK(itr != ref.end());
+        CHECK(nd->key() == *itr);
+        CHECK(nd->alone() == false);
+        ++itr;
+    }
+    CHECK(itr == ref.end());
+
+    auto ritr = ref.rbegin();
+    for (auto nd = tr.last(); nd != nullptr; nd = tree::prev(nd)) {
+        CHECK(ritr != ref.rend());
+        CHECK(nd->key() == *ritr);
+        ++ritr;
+    }
+    CHECK(ritr == ref.rend());
+}
+
+void
+test_zeroed_tree()
+{
+    alignas(tree) unsigned char buf[sizeof(tree)];
+    std::memset(buf, 0, sizeof(buf));
+    auto& tr = *reinterpret_cast<tree*>(buf);
+    expect(tr, {});
+    CHECK(tr.first() == nullptr && tr.last() == nullptr);
+    CHECK(tr.find(1) == nullptr);
+
+    obj_t a;
+    tr.insert(&a.nd, 7);
+    expect(tr, {7});
+    tr.erase(&a.nd);
+    expect(tr, {});
+}
+
+void
+test_lookup()
+{
+    obj_t o[5];
+    tree  tr;
+    const uint32_t keys[5] = { 40, 10, 30, 20, 50 };
+    for (int i = 0; i < 5; ++i) {
+        tr.insert(&o[i].nd, keys[i]);
+    }
+    expect(tr, {10, 20, 30, 40, 50});
+
+    CHECK(tr.find(30) == &o[2].nd);
+    CHECK(tr.find(35) == nullptr);
+    CHECK(tr.lower_bound(30) == &o[2].nd);
+    CHECK(tr.lower_bound(31) == &o[0].nd);
+    CHECK(tr.lower_bound(51) == nullptr);
+    CHECK(tr.lower_bound(0)  == &o[1].nd);
+    CHECK(tr.floor(30) == &o[2].nd);
+    CHECK(tr.floor(39) == &o[2].nd);
+    CHECK(tr.floor(9)  == nullptr);
+    CHECK(tr.floor(99) == &o[4].nd);
+    CHECK(tr.first() == &o[1].nd);
+    CHECK(tr.last()  == &o[4].nd);
+}
+
+void
+test_misuse()
+{
+    obj_t a;
+    obj_t b;
+    tree  tr;
+    tr.insert(&a.nd, 1);
+
+    // a linked node isn't inserted again, key stays
+    tr.insert(&a.nd, 2);
+    expect(tr, {1});
+    CHECK(a.nd.key() == 1);
+
+    // erasing a node in no tree does nothing
+    tr.erase(&b.nd);
+    tr.erase(nullptr);
+    tr.insert(nullptr, 3);
+    expect(tr, {1});
+
+    tr.erase(&a.nd);
+    CHECK(a.nd.alone());
+    tr.erase(&a.nd);
+    expect(tr, {});
+}
+
+void
+test_equal_keys()
+{
+    // a new node goes after the ones with the same key
+    const int N = 64;
+    std::vector<obj_t> o(N);
+    tree tr;
+    for (int i = 0; i < N; ++i) {
+        o[i].id = i;
+        tr.insert(&o[i].nd, i % 4);
+    }
+    CHECK(tr.valid());
+
+    uint32_t last_key = 0;
+    int      last_id  = -1;
+    for (auto nd = tr.first(); nd != nullptr; nd = tree::next(nd)) {
+        if (nd->key() != last_key) {
+            last_id = -1;
+        }
+        CHECK((int)(*nd)->id > last_id);
+        last_key = nd->key();
+        last_id  = (*nd)->id;
+    }
+    CHECK(tr.find(2)->get()->id == 2);
+}
+
+// random insert/erase rounds against std::multiset, invariants
+// checked after each round
+void
+test_random()
+{
+    const int N = 20000;
+    std::vector<obj_t> o(N);
+    std::multiset<uint32_t> ref;
+    tree tr;
+    std::mt19937 rng(24);
+
+    for (int round = 0; round < 40; ++round) {
+        // keys from a small range, plenty of duplicates
+        uint32_t range = round % 2 ? 1000 : 0xFFFFFFFF;
+        for (int k = 0; k < N; ++k) {
+            auto& x = o[rng() % N];
+            if (x.nd.alone()) {
+                uint32_t key = rng() % range;
+                tr.insert(&x.nd, key);
+                ref.insert(key);
+            } else {
+                ref.erase(ref.find(x.nd.key()));
+                tr.erase(&x.nd);
+                CHECK(x.nd.alone());
+            }
+        }
+        expect(tr, ref);
+
+        for (int q = 0; q < 200; ++q) {
+            uint32_t key = rng() % range;
+
+            auto lb = ref.lower_bound(key);
+            auto nd = tr.lower_bound(key);
+            CHECK((nd == nullptr) == (lb == ref.end()));
+            if (nd != nullptr) {
+                CHECK(nd->key() == *lb);
+                // the first of equal keys
+                auto pv = tree::prev(nd);
+                CHECK(pv == nullptr || pv->key() < key);
+            }
+
+            auto ub = ref.upper_bound(key);
+            auto fl = tr.floor(key);
+            CHECK((fl == nullptr) == (ub == ref.begin()));
+            if (fl != nullptr) {
+                CHECK(fl->key() == *std::prev(ub));
+            }
+
+            auto fd = tr.find(key);
+            CHECK((fd != nullptr) == (ref.count(key) > 0));
+        }
+    }
+
+    // drain in key order
+    while (tr.empty() == false) {
+        auto nd = tr.first();
+        CHECK(nd->key() == *ref.begin());
+        ref.erase(ref.begin());
+        tr.erase(nd);
+    }
+    expect(tr, ref);
+}
+
+} // namespace
+
+int
+main()
+{
+    std::printf("rbtree_t\n");
+    RUN(test_zeroed_tree);
+    RUN(test_lookup);
+    RUN(test_misuse);
+    RUN(test_equal_keys);
+    RUN(test_random);
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "check.h"
+#include <rbtree.h>
+#include <heap.h>
+#include <random>
+#include <set>
+#include <vector>
+
+using lkl::rbtree_t;
+using lkl::rbnode_t;
+using lkl::heap_t;
+using lkl::hnode_t;
+
+/*
+ * rbtree_t and heap_t under 1M insert/erase operations, std::multiset
+ * doing the same work for scale. a working set of 64k objects is
+ * churned: each step takes one object out and puts it back with a new
+ * key, like timers being rearmed. built with NDEBUG.
+ */
+
+namespace {
+
+struct obj_t
+{
+    uint32_t                  key = 0;
+    rbnode_t<obj_t, uint32_t> rn;
+    hnode_t<obj_t>            hn;
+
+    obj_t() : rn(this), hn(this) { }
+
+    bool operator<(const obj_t& other) const {
+        return key < other.key;
+    }
+};
+
+const uint32_t N   = 1u << 16;
+const uint32_t OPS = 1000000;
+
+void
+report(const char* what, double ns)
+{
+    std::printf("  %-36s %8.2f ns/op\n", what, ns);
+}
+
+} // namespace
+
+int
+main()
+{
+    std::vector<obj_t>    o(N);
+    std::vector<uint32_t> keys(OPS);
+    std::vector<uint32_t> pick(OPS);
+    std::mt19937 rng(1000000);
+    for (uint32_t i = 0; i < N; ++i) {
+        o[i].key = rng();
+    }
+    for (uint32_t i = 0; i < OPS; ++i) {
+        keys[i] = rng();
+        pick[i] = rng() % N;
+    }
+    uint64_t sum = 0;
+
+    std::printf("%u objects, %u operations\n", N, OPS);
+
+    // rbtree: erase a random object, insert it with a new key
+    {
+        rbtree_t<obj_t, uint32_t> tr;
+        for (auto& x : o) {
+            tr.insert(&x.rn, x.key);
+        }
+        auto beg = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < OPS; i += 2) {
+            auto& x = o[pick[i]];
+            tr.erase(&x.rn);
+            tr.insert(&x.rn, keys[i]);
+        }
+        report("rbtree_t insert/erase", ns_per_op(beg, OPS));
+
+        beg = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < OPS; ++i) {
+            auto nd = tr.floor(keys[i]);
+            sum += nd != nullptr ? nd->key() : 0;
+        }
+        report("rbtree_t floor", ns_per_op(beg, OPS));
+        CHECK(tr.size() == N);
+    }
+
+    // same churn on std::multiset, which allocates
+    {
+        std::multiset<uint32_t> ms;
+        std::vector<std::multiset<uint32_t>::iterator> pos(N);
+        for (uint32_t i = 0; i < N; ++i) {
+            pos[i] = ms.insert(o[i].key);
+        }
+        auto beg = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < OPS; i += 2) {
+            uint32_t p = pick[i];
+            ms.erase(pos[p]);
+            pos[p] = ms.insert(keys[i]);
+        }
+        report("std::multiset insert/erase", ns_per_op(beg, OPS));
+        CHECK(ms.size() == N);
+    }
+
+    // heap: pop the earliest and push it back later, like the sleep
+    // queue; then remove arbitrary members, like woken sleepers
+    {
+        heap_t<obj_t> hp;
+        for (auto& x : o) {
+            hp.push(&x.hn);
+        }
+        auto beg = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < OPS; i += 2) {
+            auto x = hp.pop()->get();
+            x->key += keys[i] >> 8;
+            hp.push(&x->hn);
+        }
+        report("heap_t pop/push", ns_per_op(beg, OPS));
+
+        beg = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < OPS; i += 2) {
+            auto& x = o[pick[i]];
+            hp.remove(&x.hn);
+            x.key = keys[i];
+            hp.push(&x.hn);
+        }
+        report("heap_t remove/push", ns_per_op(beg, OPS));
+        CHECK(hp.size() == N);
+        sum += (*hp.top())->key;
+    }
+
+    std::printf("  (checksum %llu)\n", (unsigned long long)sum);
+    return 0;
+}